@@ -0,0 +1,240 @@
+#pragma once
+#include "BlockAccessor.h"
+#include "BlockType.h"
+#include "Coord.h"
+#include "Pathfinding.h"
+#include "World.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// Lower bound on the moves from `from` to `to`, ignoring terrain. Going down
+// takes one fall per row plus the horizontal walk; going up, each diagonal
+// climb covers a row and a column at once. It is the exact distance with no
+// blocks in the way, so it never overestimates.
+inline int gravity_heuristic(Coord from, Coord to) {
+  int dx = std::abs(to.x - from.x);
+  int dy = to.y - from.y; // y grows downward
+  return dy > 0 ? dx + dy : std::max(dx, -dy);
+}
+
+// Counters for comparing searches; PathContext::nodes_expanded counts the
+// same thing for BFS.
+struct PathStats {
+  size_t searches = 0;
+  size_t found = 0;
+  size_t nodes_expanded = 0;
+  size_t nodes_pushed = 0;
+};
+
+// A* over the bfs_findpath moves with gravity_heuristic, a binary heap, and
+// the same dense stamped grid as PathContext (sized for the longest search,
+// no allocations per query).
+//
+// With jump points on, a walk is carried on along a run of identical
+// columns (same blocks from one above to three below) without putting the
+// cells in between on the heap; the run stops where the terrain changes, at
+// the target's column, or after MAX_JUMP cells. That cuts the heap work on
+// long flat stretches a lot, at the price of paths that can be a step or two
+// longer than the shortest one. Every move on the path is still legal.
+class AStarPathfinder {
+public:
+  explicit AStarPathfinder(int max_cost = 120) { reserve(max_cost); }
+
+  void set_jump_points(bool on) { jump_points = on; }
+  bool uses_jump_points() const { return jump_points; }
+
+  // Shortest path from s to tar of at most max_cost moves, or empty. Owned by
+  // the pathfinder, valid until the next query.
+  const std::vector<Coord> &find_path(Coord s, Coord tar, World &world,
+                                      int max_cost = 120) {
+    BlockAccessor blocks(world);
+    return find_path_in(
+        s, tar, [&](int x, int y) { return blocks.get_block(x, y); },
+        max_cost);
+  }
+
+  // find_path over any `block_at(x, y)`, e.g. a ResidentBlocks for searches
+  // that must not touch the world.
+  template <typename BlockAt>
+  const std::vector<Coord> &find_path_in(Coord s, Coord tar, BlockAt &&block_at,
+                                         int max_cost = 120) {
+    path.clear();
+    ++totals.searches;
+    last_expanded = 0;
+    if (s == tar) {
+      path.push_back(s);
+      ++totals.found;
+      return path;
+    }
+    if (gravity_heuristic(s, tar) > max_cost)
+      return path;
+    if (max_cost > range)
+      reserve(max_cost);
+
+    if (++generation == 0) {
+      std::fill(seen.begin(), seen.end(), 0u);
+      std::fill(closed.begin(), closed.end(), 0u);
+      generation = 1;
+    }
+
+    origin = {s.x - range, s.y - range};
+    heap.clear();
+    open(index_of(s), 0, NO_PARENT, gravity_heuristic(s, tar));
+
+    bool found = false;
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), worse);
+      Node node = heap.back();
+      heap.pop_back();
+      if (closed[node.index] == generation or node.g != g[node.index])
+        continue;
+      closed[node.index] = generation;
+      ++last_expanded;
+
+      Coord cur = coord_of(node.index);
+      if (cur == tar) {
+        found = true;
+        break;
+      }
+
+      for (uint8_t k = 0; k < 6; ++k) {
+        const Coord dir = PATH_DIRS[k];
+        Coord nei = cur + dir;
+        int cost = node.g + 1;
+        if (cost > max_cost or !inside(nei))
+          continue;
+        int first = index_of(nei);
+        if (closed[first] == generation or
+            (seen[first] == generation and g[first] <= cost))
+          continue;
+        if (!can_step(block_at, cur, dir))
+          continue;
+
+        if (jump_points and dir.y == 0) {
+          uint8_t shape = column_shape(block_at, cur);
+          int steps = 0;
+          while (steps < MAX_JUMP and cost < max_cost and nei.x != tar.x and
+                 inside(nei + dir) and column_shape(block_at, nei) == shape and
+                 can_step(block_at, nei, dir)) {
+            int j = index_of(nei);
+            if (closed[j] == generation or
+                (seen[j] == generation and g[j] <= cost))
+              break;
+            // Passed over: recorded for the path, not queued.
+            seen[j] = generation;
+            g[j] = cost;
+            parent_dir[j] = k;
+            nei = nei + dir;
+            ++cost;
+            ++steps;
+          }
+        }
+
+        int j = index_of(nei);
+        if (closed[j] == generation)
+          continue;
+        if (seen[j] == generation and g[j] <= cost)
+          continue;
+        open(j, cost, k, cost + gravity_heuristic(nei, tar));
+      }
+    }
+
+    totals.nodes_expanded += last_expanded;
+    if (!found)
+      return path;
+    ++totals.found;
+
+    Coord cur = tar;
+    while (cur != s) {
+      path.push_back(cur);
+      cur = cur - PATH_DIRS[parent_dir[index_of(cur)]];
+    }
+    path.push_back(s);
+    std::reverse(path.begin(), path.end());
+    return path;
+  }
+
+  const PathStats &stats() const { return totals; }
+  size_t last_nodes_expanded() const { return last_expanded; }
+  void reset_stats() { totals = PathStats{}; }
+
+private:
+  static constexpr uint8_t NO_PARENT = 0xFF;
+  static constexpr int MAX_JUMP = 16;
+
+  struct Node {
+    int f;
+    int g;
+    int index;
+  };
+
+  // Heap order: lowest f first; on ties the deeper node, which is closer to
+  // the target.
+  static bool worse(const Node &a, const Node &b) {
+    return a.f != b.f ? a.f > b.f : a.g < b.g;
+  }
+
+  bool jump_points = false;
+  int range = 0;
+  int side = 0;
+  Coord origin;
+  uint32_t generation = 0;
+  size_t last_expanded = 0;
+  PathStats totals;
+
+  std::vector<uint32_t> seen;
+  std::vector<uint32_t> closed;
+  std::vector<uint16_t> g;
+  std::vector<uint8_t> parent_dir;
+  std::vector<Node> heap;
+  std::vector<Coord> path;
+
+  void reserve(int max_cost) {
+    range = max_cost;
+    side = 2 * max_cost + 1;
+    size_t cells = static_cast<size_t>(side) * side;
+    seen.assign(cells, 0u);
+    closed.assign(cells, 0u);
+    g.assign(cells, 0);
+    parent_dir.assign(cells, NO_PARENT);
+    heap.reserve(cells);
+    path.reserve(max_cost + 1);
+    generation = 0;
+  }
+
+  void open(int index, int cost, uint8_t parent, int f) {
+    seen[index] = generation;
+    g[index] = static_cast<uint16_t>(cost);
+    parent_dir[index] = parent;
+    heap.push_back({f, cost, index});
+    std::push_heap(heap.begin(), heap.end(), worse);
+    ++totals.nodes_pushed;
+  }
+
+  bool inside(Coord c) const {
+    return c.x >= origin.x and c.x < origin.x + side and c.y >= origin.y and
+           c.y < origin.y + side;
+  }
+
+  int index_of(Coord c) const {
+    return (c.y - origin.y) * side + (c.x - origin.x);
+  }
+
+  Coord coord_of(int i) const {
+    return {origin.x + i % side, origin.y + i / side};
+  }
+
+  // Which of the cells from one above to three below `c` are AIR: everything
+  // can_step looks at for moves out of this column.
+  template <typename BlockAt>
+  static uint8_t column_shape(BlockAt &block_at, Coord c) {
+    uint8_t shape = 0;
+    for (int dy = -1; dy <= 3; ++dy) {
+      shape = static_cast<uint8_t>(
+          (shape << 1) | (block_at(c.x, c.y + dy) == BlockType::AIR));
+    }
+    return shape;
+  }
+};
@@ -0,0 +1,282 @@
+#pragma once
+#include "Mob.h"
+#include "MobStorage.h"
+#include "RegionFile.h"
+#include "World.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+constexpr int INVENTORY_SLOTS = 9;
+
+struct PlayerState {
+  int x = 0;
+  int y = 0;
+  int facing = 1;
+  int inventory[INVENTORY_SLOTS] = {};
+  int selected_block = 1;
+};
+
+// The player and the mobs, saved next to the region files. Layout (host byte
+// order, like the region files):
+//
+//   uint32 magic, uint32 version
+//   int32 x, y, facing, inventory[INVENTORY_SLOTS], selected_block
+//   uint32 mob count n, then the MobStorage columns:
+//     int32 x[n], int16 y[n], int16 hp[n], uint8 type[n], uint8 state[n]
+constexpr uint32_t STATE_MAGIC = 0x54415453; // "STAT"
+constexpr uint32_t STATE_VERSION = 1;
+
+inline void encode_game_state(const PlayerState &player,
+                              const MobStorage &mobs,
+                              std::vector<uint8_t> &out) {
+  auto put = [&](const void *data, size_t bytes) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    out.insert(out.end(), p, p + bytes);
+  };
+  auto put_int = [&](int32_t v) { put(&v, sizeof(v)); };
+  const uint32_t header[2] = {STATE_MAGIC, STATE_VERSION};
+  put(header, sizeof(header));
+  put_int(player.x);
+  put_int(player.y);
+  put_int(player.facing);
+  for (int count : player.inventory)
+    put_int(count);
+  put_int(player.selected_block);
+
+  uint32_t n = static_cast<uint32_t>(mobs.count());
+  out.reserve(out.size() + sizeof(n) +
+              n * (sizeof(*mobs.x) + sizeof(*mobs.y) + sizeof(*mobs.hp) +
+                   sizeof(*mobs.type) + sizeof(*mobs.state)));
+  put(&n, sizeof(n));
+  put(mobs.x, n * sizeof(*mobs.x));
+  put(mobs.y, n * sizeof(*mobs.y));
+  put(mobs.hp, n * sizeof(*mobs.hp));
+  put(mobs.type, n * sizeof(*mobs.type));
+  put(mobs.state, n * sizeof(*mobs.state));
+}
+
+// False (and nothing changed) if the file is missing or damaged.
+inline bool load_game_state(const std::filesystem::path &path,
+                            PlayerState &player, std::vector<Mob> &mobs) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  size_t at = 0;
+  auto get = [&](void *out, size_t bytes) {
+    if (data.size() - at < bytes)
+      return false;
+    std::memcpy(out, data.data() + at, bytes);
+    at += bytes;
+    return true;
+  };
+
+  uint32_t header[2];
+  PlayerState p;
+  int32_t fields[4 + INVENTORY_SLOTS];
+  uint32_t n = 0;
+  if (!get(header, sizeof(header)) or header[0] != STATE_MAGIC or
+      header[1] != STATE_VERSION or
+      !get(fields, sizeof(fields)) or !get(&n, sizeof(n)))
+    return false;
+  p.x = fields[0];
+  p.y = fields[1];
+  p.facing = fields[2];
+  std::copy_n(fields + 3, INVENTORY_SLOTS, p.inventory);
+  p.selected_block = fields[3 + INVENTORY_SLOTS];
+
+  const size_t row = sizeof(int32_t) + 2 * sizeof(int16_t) + 2;
+  if ((data.size() - at) != static_cast<size_t>(n) * row)
+    return false;
+  std::vector<int32_t> xs(n);
+  std::vector<int16_t> ys(n), hps(n);
+  std::vector<uint8_t> types(n), states(n);
+  get(xs.data(), n * sizeof(int32_t));
+  get(ys.data(), n * sizeof(int16_t));
+  get(hps.data(), n * sizeof(int16_t));
+  get(types.data(), n);
+  get(states.data(), n);
+
+  std::vector<Mob> loaded;
+  loaded.reserve(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    if (types[i] >= static_cast<uint8_t>(MobType::COUNT) or
+        states[i] > static_cast<uint8_t>(AIState::IDLE))
+      return false;
+    loaded.push_back({xs[i], ys[i], hps[i], static_cast<MobType>(types[i]),
+                      static_cast<AIState>(states[i])});
+  }
+  player = p;
+  mobs = std::move(loaded);
+  return true;
+}
+
+struct AutosaveStats {
+  size_t saves = 0;
+  size_t failures = 0;
+  size_t chunks_saved = 0;
+  // Time start() took on the calling thread, and the background write.
+  double last_snapshot_ms = 0;
+  double worst_snapshot_ms = 0;
+  double last_write_ms = 0;
+};
+
+// Saves the world's edited chunks and the player and mob state without
+// holding up the game loop. start() copies them on the calling thread (see
+// World::snapshot_dirty; the mob columns are a few memcpys), a background
+// thread encodes, writes and syncs them, and poll() marks the chunks saved
+// and trims the change journal up to the snapshot, whose edits are on disk.
+//
+// The world and the store are only touched from the calling thread, apart
+// from RegionStore::save, which is safe alongside loads.
+class Autosaver {
+public:
+  Autosaver(World &w, RegionStore &s, std::filesystem::path state)
+      : world(w), store(s), state_file(std::move(state)),
+        worker([this] { run(); }) {}
+
+  // Finishes the save in flight (without marking it in the world).
+  ~Autosaver() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+  }
+
+  // Start saving unless a save is still running; returns whether it
+  // started.
+  bool start(const PlayerState &player, const MobStorage &mobs) {
+    if (running)
+      return false;
+    auto begin = std::chrono::steady_clock::now();
+    job.snapshot = world.snapshot_dirty();
+    job.state.clear();
+    encode_game_state(player, mobs, job.state);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending = true;
+    }
+    wake.notify_all();
+    running = true;
+
+    counters.last_snapshot_ms =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - begin)
+            .count();
+    counters.worst_snapshot_ms =
+        std::max(counters.worst_snapshot_ms, counters.last_snapshot_ms);
+    return true;
+  }
+
+  // Call once per frame: applies a save the thread has finished.
+  void poll() {
+    if (!running)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!finished)
+        return;
+      finished = false;
+    }
+    running = false;
+    counters.last_write_ms = job.write_ms;
+    if (!job.ok) {
+      ++counters.failures;
+      job.snapshot = SaveSnapshot(); // drop the shared blocks here
+      return;
+    }
+    world.finish_save(job.snapshot);
+    world.trim_changes(job.snapshot.journal_end);
+    ++counters.saves;
+    counters.chunks_saved +=
+        job.snapshot.edited.size() + job.snapshot.spilled.size();
+  }
+
+  // Block until the save in flight (if any) is done, then poll().
+  void wait() {
+    if (!running)
+      return;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this] { return finished; });
+    }
+    poll();
+  }
+
+  // A whole save on the spot, e.g. on exit. False if it failed.
+  bool save_now(const PlayerState &player, const MobStorage &mobs) {
+    wait();
+    size_t failures = counters.failures;
+    start(player, mobs);
+    wait();
+    return counters.failures == failures;
+  }
+
+  bool busy() const { return running; }
+  const AutosaveStats &stats() const { return counters; }
+
+private:
+  World &world;
+  RegionStore &store;
+  std::filesystem::path state_file;
+
+  // Owned by the worker from `pending` until `finished`, by the calling
+  // thread otherwise.
+  struct Job {
+    SaveSnapshot snapshot;
+    std::vector<uint8_t> state;
+    bool ok = false;
+    double write_ms = 0;
+  } job;
+  bool running = false; // calling thread only
+  AutosaveStats counters;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool pending = false;
+  bool finished = false;
+  bool stopping = false;
+  std::thread worker; // last: starts once everything above exists
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this] { return pending or stopping; });
+      if (!pending)
+        return;
+      pending = false;
+      lock.unlock();
+
+      auto begin = std::chrono::steady_clock::now();
+      bool ok = job.snapshot.write(store);
+      std::error_code error;
+      if (state_file.has_parent_path())
+        std::filesystem::create_directories(state_file.parent_path(), error);
+      std::filesystem::path temp = state_file;
+      temp += ".tmp";
+      ok = write_file_synced(temp, job.state.data(), job.state.size()) and
+           replace_file(temp, state_file) and ok;
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - begin)
+                      .count();
+
+      lock.lock();
+      job.ok = ok;
+      job.write_ms = ms;
+      finished = true;
+      wake.notify_all();
+    }
+  }
+};
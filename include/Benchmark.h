@@ -1,9 +1,24 @@
 #pragma once
+#include "AStar.h"
+#include "Autosave.h"
 #include "FastRand.h"
+#include "FlowField.h"
+#include "GameWindow.h"
 #include "Mob.h"
 #include "MobStorage.h"
+#include "PackedBlocks.h"
+#include "Pathfinding.h"
+#include "RegionFile.h"
+#include "Terrain.h"
+#include "World.h"
+#include <algorithm>
 #include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 inline void run_aos_vs_soa_benchmark() {
@@ -108,3 +123,1031 @@ inline void run_aos_vs_soa_benchmark() {
 
   std::cout << "\n========================================\n\n";
 }
+
+
+inline void run_terrain_benchmark() {
+  const int NUM_CHUNKS = 2000;
+  using Blocks = std::array<std::array<BlockType, CHUNK_SIZE>, CHUNK_SIZE>;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   TERRAIN GENERATION BENCHMARK\n";
+  std::cout << "   " << NUM_CHUNKS << " chunks, noise per cell vs per row\n";
+  std::cout << "========================================\n\n";
+
+  Blocks blocks;
+  volatile int sink = 0;
+
+  auto time_chunks = [&](auto generate) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int cx = 0; cx < NUM_CHUNKS; cx++) {
+      generate(blocks, cx);
+      sink = sink + static_cast<int>(blocks[CHUNK_SIZE / 2][cx & 31]);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    return NUM_CHUNKS / secs;
+  };
+
+  double reference = time_chunks(
+      [](Blocks &b, int cx) { generate_chunk_terrain_reference(b, cx, 0); });
+  double batched = time_chunks(
+      [](Blocks &b, int cx) { generate_chunk_terrain(b, cx, 0); });
+  (void)sink;
+
+  std::cout << "Per-cell noise:   " << static_cast<long>(reference)
+            << " chunks/s\n";
+  std::cout << "Batched rows:     " << static_cast<long>(batched)
+            << " chunks/s\n";
+  std::cout << "Speedup:          " << batched / reference << "x\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_chunk_lookup_benchmark() {
+  const int CHUNKS_X = 128;
+  const int NUM_LOOKUPS = 2000000;
+
+  // World's previous storage: node-based map with the old x ^ y * K hash.
+  struct LegacyCoordHash {
+    size_t operator()(const Coord &c) const {
+      size_t h1 = std::hash<int>{}(c.x);
+      size_t h2 = std::hash<int>{}(c.y);
+      return h1 ^ (h2 * 2654435761u);
+    }
+  };
+  struct MapWorld {
+    std::unordered_map<Coord, std::unique_ptr<Chunk>, LegacyCoordHash> chunks;
+
+    BlockType get_block(int wx, int wy) {
+      auto to_chunk = [](int w) {
+        return w >= 0 ? w / CHUNK_SIZE : (w - CHUNK_SIZE + 1) / CHUNK_SIZE;
+      };
+      Coord pos = {to_chunk(wx), to_chunk(wy)};
+      auto it = chunks.find(pos);
+      if (it == chunks.end()) {
+        it = chunks.emplace(pos, std::make_unique<Chunk>(pos)).first;
+      }
+      int cx = ((wx % CHUNK_SIZE) + CHUNK_SIZE) % CHUNK_SIZE;
+      int cy = ((wy % CHUNK_SIZE) + CHUNK_SIZE) % CHUNK_SIZE;
+      return it->second->get_block(cx, cy);
+    }
+  };
+
+  std::cout << "\n========================================\n";
+  std::cout << "   CHUNK LOOKUP BENCHMARK\n";
+  std::cout << "   " << CHUNKS_X * 3 << " chunks, " << NUM_LOOKUPS
+            << " get_block calls\n";
+  std::cout << "========================================\n\n";
+
+  const int min_x = -CHUNKS_X / 2 * CHUNK_SIZE;
+  const int span_x = CHUNKS_X * CHUNK_SIZE;
+  const int min_y = -CHUNK_SIZE;
+  const int span_y = 3 * CHUNK_SIZE;
+
+  MapWorld map_world;
+  World flat_world;
+  for (int cx = 0; cx < CHUNKS_X; cx++) {
+    for (int cy = 0; cy < 3; cy++) {
+      map_world.get_block(min_x + cx * CHUNK_SIZE, min_y + cy * CHUNK_SIZE);
+      flat_world.get_block(min_x + cx * CHUNK_SIZE, min_y + cy * CHUNK_SIZE);
+    }
+  }
+
+  std::vector<Coord> random_cells(NUM_LOOKUPS);
+  for (Coord &c : random_cells) {
+    c = {min_x + static_cast<int>(fast_rand() % span_x),
+         min_y + static_cast<int>(fast_rand() % span_y)};
+  }
+
+  volatile int sink = 0;
+  auto ns_per_lookup = [&](auto &world, bool random) {
+    int acc = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (random) {
+      for (const Coord &c : random_cells) {
+        acc += static_cast<int>(world.get_block(c.x, c.y));
+      }
+    } else {
+      // Row-major sweeps over the loaded area, wrapping around.
+      for (int i = 0; i < NUM_LOOKUPS; i++) {
+        int x = min_x + i % span_x;
+        int y = min_y + (i / span_x) % span_y;
+        acc += static_cast<int>(world.get_block(x, y));
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    sink = sink + acc;
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           NUM_LOOKUPS;
+  };
+
+  double map_seq = ns_per_lookup(map_world, false);
+  double flat_seq = ns_per_lookup(flat_world, false);
+  double map_rand = ns_per_lookup(map_world, true);
+  double flat_rand = ns_per_lookup(flat_world, true);
+  (void)sink;
+
+  std::cout << "Sequential: unordered_map " << map_seq << " ns, ChunkTable "
+            << flat_seq << " ns (" << map_seq / flat_seq << "x)\n";
+  std::cout << "Random:     unordered_map " << map_rand << " ns, ChunkTable "
+            << flat_rand << " ns (" << map_rand / flat_rand << "x)\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_render_benchmark() {
+  const int NUM_FRAMES = 2000;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   RENDER LOOP BENCHMARK\n";
+  std::cout << "   " << NUM_FRAMES << " frames of " << SCREEN_WIDTH << "x"
+            << SCREEN_HEIGHT << "\n";
+  std::cout << "========================================\n\n";
+
+  World world;
+  ScreenBuffer screen;
+  int player_x = 16, player_y = 10, facing = 1, selected = 1;
+  int inventory[9] = {0};
+  GameWindow game(world, player_x, player_y, facing, inventory, selected);
+  for (int x = -96; x < 128; x += CHUNK_SIZE) {
+    for (int y = -CHUNK_SIZE; y < 2 * CHUNK_SIZE; y += CHUNK_SIZE) {
+      world.get_block(x, y);
+    }
+  }
+
+  // The terrain part of GameWindow::render before copy_region: one
+  // World::get_block per cell, four more per ore.
+  auto legacy_render = [&]() {
+    screen.clear();
+    int cam_x = player_x - SCREEN_WIDTH / 2;
+    int cam_y = player_y - SCREEN_HEIGHT / 2;
+    for (int sy = 0; sy < SCREEN_HEIGHT; ++sy) {
+      for (int sx = 0; sx < SCREEN_WIDTH; ++sx) {
+        int wx = cam_x + sx;
+        int wy = cam_y + sy;
+        BlockType block = world.get_block(wx, wy);
+        bool is_ore = block == BlockType::DIAMOND or
+                      block == BlockType::GOLD or block == BlockType::IRON;
+        if (is_ore and !(world.get_block(wx, wy + 1) == BlockType::AIR or
+                         world.get_block(wx + 1, wy) == BlockType::AIR or
+                         world.get_block(wx - 1, wy) == BlockType::AIR or
+                         world.get_block(wx, wy - 1) == BlockType::AIR)) {
+          block = BlockType::STONE;
+        }
+        screen.set_pixel(sx, sy, block_to_pixel(block));
+      }
+    }
+  };
+
+  auto us_per_frame = [&](auto render) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < NUM_FRAMES; f++) {
+      player_x = 16 + (f % 64); // walk back and forth over a chunk border
+      render();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           NUM_FRAMES;
+  };
+
+  double before = us_per_frame(legacy_render);
+  double after = us_per_frame([&]() { game.render(screen); });
+
+  std::cout << "World::get_block per cell: " << before << " us/frame\n";
+  std::cout << "GameWindow::render (incl. HUD): " << after << " us/frame\n";
+  std::cout << "Speedup: " << before / after << "x\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+// One frame of recorded input per character: a/d walk, w jump, the arrow
+// keys as h/j/k/l mine (left/down/up/right), '.' is an idle frame.
+inline InputState replay_input(char key) {
+  InputState state;
+  switch (key) {
+  case 'a':
+    state.move_left = true;
+    break;
+  case 'd':
+    state.move_right = true;
+    break;
+  case 'w':
+    state.jump = true;
+    break;
+  case 'h':
+    state.mine_left = true;
+    break;
+  case 'j':
+    state.mine_down = true;
+    break;
+  case 'k':
+    state.mine_up = true;
+    break;
+  case 'l':
+    state.mine_right = true;
+    break;
+  }
+  return state;
+}
+
+// A short play session: look around, walk east, dig down, tunnel, idle,
+// walk back west.
+inline const std::string RECORDED_SESSION =
+    "..........dddddddddddddddddddd....w...dddddddddd..........jjjjj....."
+    "lllll....hhhhh..........................................dddddddd"
+    "ddddddddwdddddddd..............aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+    "aaaaaaaaaaaa..........................................kkkk......";
+
+inline void run_screen_diff_benchmark() {
+  const int NUM_REPLAYS = 20;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   TERMINAL OUTPUT BENCHMARK\n";
+  std::cout << "   " << NUM_REPLAYS << " replays of a "
+            << RECORDED_SESSION.size() << "-frame session\n";
+  std::cout << "========================================\n\n";
+
+  struct Result {
+    size_t bytes;
+    size_t full_redraws;
+    double us_per_frame;
+  };
+
+  auto replay = [&](float full_redraw_ratio) {
+    ScreenBuffer screen;
+    screen.set_full_redraw_ratio(full_redraw_ratio);
+    std::string out;
+    double total_us = 0;
+    for (int r = 0; r < NUM_REPLAYS; r++) {
+      seed_fast_rand(12345);
+      World world;
+      int player_x = 40, player_y = 0, facing = 1, selected = 1;
+      int inventory[9] = {0};
+      while (world.get_block(player_x, player_y + 1) == BlockType::AIR)
+        ++player_y;
+      GameWindow game(world, player_x, player_y, facing, inventory, selected);
+      for (char key : RECORDED_SESSION) {
+        world.begin_frame();
+        game.handle_input(replay_input(key));
+        game.update(1.0 / 20.0); // recorded at 20 frames per second
+        auto start = std::chrono::high_resolution_clock::now();
+        game.render(screen);
+        screen.compose_frame(out);
+        auto end = std::chrono::high_resolution_clock::now();
+        total_us += std::chrono::duration<double, std::micro>(end - start)
+                        .count();
+      }
+    }
+    return Result{screen.total_bytes_written(), screen.total_full_redraws(),
+                  total_us / screen.total_frames()};
+  };
+
+  Result full = replay(0.0f);
+  Result diff = replay(0.5f);
+  size_t frames = NUM_REPLAYS * RECORDED_SESSION.size();
+
+  std::cout << "Full redraw:  " << full.bytes / frames << " bytes/frame, "
+            << full.us_per_frame << " us/frame\n";
+  std::cout << "Differential: " << diff.bytes / frames << " bytes/frame, "
+            << diff.us_per_frame << " us/frame (" << diff.full_redraws
+            << " full redraws)\n";
+  std::cout << "Bytes saved:  "
+            << 100.0 - 100.0 * static_cast<double>(diff.bytes) / full.bytes
+            << "%\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_chunk_packing_benchmark() {
+  const int SIDE = 64; // SIDE x SIDE chunks
+  const int NUM_READS = 20;
+  // What every chunk held before packing: 1 KiB of blocks, exposure and
+  // dirty masks, position and counters.
+  const size_t FLAT_CHUNK_BYTES =
+      sizeof(ChunkBlocks) + 2 * CHUNK_SIZE * sizeof(uint32_t) + 16;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   PACKED CHUNK BENCHMARK\n";
+  std::cout << "   " << SIDE * SIDE << " chunks, packed vs flat\n";
+  std::cout << "========================================\n\n";
+
+  World world;
+  for (int cy = 0; cy < SIDE; cy++) {
+    for (int cx = -SIDE / 2; cx < SIDE / 2; cx++)
+      world.get_chunk({cx, cy});
+  }
+  size_t packed_bytes = world.chunk_memory_bytes();
+  size_t flat_bytes = world.chunk_count() * FLAT_CHUNK_BYTES;
+  // Chunks wholly below the bedrock floor hold no blocks of their own.
+  size_t uniform_chunks = 0;
+  for (int cy = 0; cy < SIDE; cy++) {
+    for (int cx = -SIDE / 2; cx < SIDE / 2; cx++)
+      uniform_chunks += world.get_chunk({cx, cy}).memory_bytes() ==
+                        sizeof(Chunk);
+  }
+
+  // Whole chunk rows through copy_region, as the renderer and flow field
+  // read them.
+  const int W = SIDE * CHUNK_SIZE, H = 2 * CHUNK_SIZE;
+  std::vector<BlockType> region(static_cast<size_t>(W) * H);
+  auto time_reads = [&] {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < NUM_READS; r++)
+      world.copy_region(-W / 2, 0, W, H, region.data());
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+           NUM_READS;
+  };
+  double packed_us = time_reads();
+
+  for (int cy = 0; cy < SIDE; cy++) {
+    for (int cx = -SIDE / 2; cx < SIDE / 2; cx++)
+      world.get_chunk({cx, cy}).unpack();
+  }
+  size_t unpacked_bytes = world.chunk_memory_bytes();
+  double flat_us = time_reads();
+
+  std::cout << "Flat layout:     " << flat_bytes / 1024 << " KiB ("
+            << FLAT_CHUNK_BYTES << " bytes/chunk)\n";
+  std::cout << "Packed:          " << packed_bytes / 1024 << " KiB ("
+            << packed_bytes / world.chunk_count() << " bytes/chunk, "
+            << static_cast<double>(flat_bytes) / packed_bytes
+            << "x smaller)\n";
+  std::cout << "Uniform chunks:  " << uniform_chunks << " of "
+            << world.chunk_count() << " (" << sizeof(Chunk)
+            << " bytes each)\n";
+  std::cout << "All unpacked:    " << unpacked_bytes / 1024 << " KiB\n";
+  std::cout << "copy_region " << W << "x" << H << ": packed " << packed_us
+            << " us, flat " << flat_us << " us\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_region_file_benchmark() {
+  const int SIDE = 100; // SIDE x SIDE chunks, one edit in each
+  const int NUM_CHUNKS = SIDE * SIDE;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   REGION FILE BENCHMARK\n";
+  std::cout << "   save and load of " << NUM_CHUNKS << " edited chunks\n";
+  std::cout << "========================================\n\n";
+
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "region_bench";
+  std::filesystem::remove_all(dir);
+  auto ms_since = [](auto start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+  };
+
+  double generate_ms, save_ms, load_ms;
+  size_t bytes;
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int cy = 0; cy < SIDE; cy++) {
+      for (int cx = -SIDE / 2; cx < SIDE / 2; cx++)
+        world.get_chunk({cx, cy});
+    }
+    generate_ms = ms_since(start);
+    for (int cy = 0; cy < SIDE; cy++) {
+      for (int cx = -SIDE / 2; cx < SIDE / 2; cx++)
+        world.set_block(cx * CHUNK_SIZE + 7, cy * CHUNK_SIZE + 3,
+                        BlockType::WOOD);
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    if (!world.save_dirty_chunks())
+      std::cout << "Save FAILED\n";
+    save_ms = ms_since(start);
+    bytes = store.stats().bytes_written;
+  }
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int cy = 0; cy < SIDE; cy++) {
+      for (int cx = -SIDE / 2; cx < SIDE / 2; cx++)
+        world.get_chunk({cx, cy});
+    }
+    load_ms = ms_since(start);
+    if (store.stats().chunks_loaded != NUM_CHUNKS)
+      std::cout << "Only " << store.stats().chunks_loaded << " loaded\n";
+  }
+  std::filesystem::remove_all(dir);
+
+  auto rate = [&](double ms) { return NUM_CHUNKS / (ms / 1000.0); };
+  std::cout << "Generate: " << generate_ms << " ms (" << rate(generate_ms)
+            << " chunks/s)\n";
+  std::cout << "Save:     " << save_ms << " ms (" << rate(save_ms)
+            << " chunks/s, " << bytes / (1024.0 * 1024.0) / (save_ms / 1000.0)
+            << " MiB/s)\n";
+  std::cout << "Load:     " << load_ms << " ms (" << rate(load_ms)
+            << " chunks/s, page cache warm)\n";
+  std::cout << "Load vs generate: " << generate_ms / load_ms << "x\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_chunk_eviction_benchmark() {
+  const int DISTANCE = 5000; // chunks walked east, then back
+  const size_t BUDGET = 2 << 20;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   CHUNK EVICTION BENCHMARK\n";
+  std::cout << "   walk " << DISTANCE << " chunks east and back, 3 chunk rows,"
+            << " an edit every 10th column\n";
+  std::cout << "========================================\n\n";
+
+  for (size_t budget : {size_t(0), BUDGET}) {
+    World world;
+    world.set_memory_budget(budget);
+    double total_ms = 0, worst_ms = 0;
+    size_t peak_bytes = 0;
+    auto walk = [&](int cx) {
+      world.begin_frame();
+      int wx = cx * CHUNK_SIZE;
+      for (int cy = 0; cy < 3; cy++)
+        world.get_chunk({cx, cy});
+      if (cx % 10 == 0) {
+        bool air = world.get_block(wx + 3, 40) == BlockType::AIR;
+        world.set_block(wx + 3, 40, air ? BlockType::WOOD : BlockType::AIR);
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      world.evict_to_budget(wx, 40);
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::high_resolution_clock::now() - start)
+                      .count();
+      total_ms += ms;
+      worst_ms = std::max(worst_ms, ms);
+      if (cx % 100 == 0)
+        peak_bytes = std::max(peak_bytes, world.chunk_memory_bytes());
+    };
+    for (int cx = 0; cx < DISTANCE; cx++)
+      walk(cx);
+    for (int cx = DISTANCE - 1; cx >= 0; cx--)
+      walk(cx);
+
+    ResidencyStats stats = world.residency();
+    std::cout << (budget ? "2 MiB budget:" : "No budget:") << "\n";
+    std::cout << "  Resident: " << stats.resident_chunks << " chunks, "
+              << stats.resident_bytes / 1024 << " KiB (peak "
+              << peak_bytes / 1024 << " KiB)\n";
+    std::cout << "  Spill: " << stats.spilled_chunks << " chunks, "
+              << stats.spilled_bytes / 1024 << " KiB\n";
+    std::cout << "  Evicted: " << stats.evicted_clean << " clean, "
+              << stats.evicted_edited << " edited; reloaded "
+              << stats.reloads << "\n";
+    std::cout << "  evict_to_budget: " << total_ms / (2 * DISTANCE)
+              << " ms/frame average, " << worst_ms << " ms worst\n";
+  }
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_autosave_benchmark() {
+  const int SIDE = 50; // SIDE x SIDE edited chunks
+  const int NUM_MOBS = 100000;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   AUTOSAVE BENCHMARK\n";
+  std::cout << "   " << SIDE * SIDE << " edited chunks and " << NUM_MOBS
+            << " mobs: blocking save vs background autosave\n";
+  std::cout << "========================================\n\n";
+
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "autosave_bench";
+  std::filesystem::remove_all(dir);
+  auto ms_since = [](auto start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+  };
+
+  RegionStore store(dir);
+  World world;
+  world.set_region_store(&store);
+  MobStorage mobs;
+  for (int i = 0; i < NUM_MOBS; i++)
+    mobs.add(i % 5000, i % 64, 20, MobType::ZOMBIE, AIState::CHASING);
+  PlayerState player;
+  auto edit_all = [&](BlockType type) {
+    for (int cy = 0; cy < SIDE; cy++) {
+      for (int cx = 0; cx < SIDE; cx++)
+        world.set_block(cx * CHUNK_SIZE + 7, cy * CHUNK_SIZE + 3, type);
+    }
+  };
+
+  edit_all(BlockType::WOOD);
+  auto start = std::chrono::high_resolution_clock::now();
+  {
+    Autosaver blocking(world, store, dir / "player.bin");
+    blocking.save_now(player, mobs);
+  }
+  double blocking_ms = ms_since(start);
+
+  edit_all(BlockType::LEAF);
+  Autosaver saver(world, store, dir / "player.bin");
+  saver.start(player, mobs);
+  // Frames keep editing while the save runs; each one polls.
+  int frames = 0;
+  double worst_frame_ms = 0;
+  while (saver.busy()) {
+    auto frame = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 10; i++)
+      world.set_block(frames * 10 + i, 70, BlockType::STONE);
+    saver.poll();
+    worst_frame_ms = std::max(worst_frame_ms, ms_since(frame));
+    frames++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const AutosaveStats &stats = saver.stats();
+  std::filesystem::remove_all(dir);
+
+  std::cout << "Blocking save:    " << blocking_ms << " ms on the game loop\n";
+  std::cout << "Autosave start:   " << stats.last_snapshot_ms
+            << " ms on the game loop (snapshot)\n";
+  std::cout << "Background write: " << stats.last_write_ms << " ms, "
+            << frames << " frames polled meanwhile, worst "
+            << worst_frame_ms << " ms\n";
+  std::cout << "Chunks saved: " << stats.chunks_saved << "\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_flow_field_benchmark() {
+  const int MOB_COUNTS[] = {10, 100, 1000, 10000};
+
+  std::cout << "\n========================================\n";
+  std::cout << "   MOB PATHFINDING BENCHMARK\n";
+  std::cout << "   one mob tick: per-mob BFS vs shared flow field\n";
+  std::cout << "========================================\n\n";
+
+  World world;
+  Coord player = {0, 0};
+  while (world.get_block(player.x, player.y + 1) == BlockType::AIR)
+    ++player.y;
+
+  for (int count : MOB_COUNTS) {
+    seed_fast_rand(777);
+    std::vector<Coord> mobs;
+    for (int i = 0; i < count; i++) {
+      Coord m = {player.x - 50 + static_cast<int>(fast_rand() % 101), 0};
+      // Topmost cell a mob can stand in.
+      while (m.y < CHUNK_SIZE - 1 and
+             (world.get_block(m.x, m.y) != BlockType::AIR or
+              world.get_block(m.x, m.y + 1) == BlockType::AIR))
+        ++m.y;
+      mobs.push_back(m);
+    }
+
+    // Repeat small ticks so the timer has something to measure.
+    const int ticks = count <= 100 ? 20 : count <= 1000 ? 4 : 1;
+    size_t moved_bfs = 0, moved_field = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int t = 0; t < ticks; t++) {
+      for (Coord m : mobs) {
+        moved_bfs += bfs_findpath(m, player, world, 30).size() >= 2;
+      }
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    FlowField field;
+    for (int t = 0; t < ticks; t++) {
+      field.build(world, player, 60, CHUNK_SIZE, 30);
+      Coord next;
+      for (Coord m : mobs) {
+        moved_field += field.next_step(m, next);
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double bfs_us =
+        std::chrono::duration<double, std::micro>(mid - start).count() / ticks;
+    double field_us =
+        std::chrono::duration<double, std::micro>(end - mid).count() / ticks;
+    std::cout << count << " zombies: BFS " << bfs_us << " us/tick, flow field "
+              << field_us << " us/tick (" << bfs_us / field_us << "x, "
+              << moved_field / ticks << "/" << moved_bfs / ticks
+              << " mobs with a path)\n";
+  }
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_path_context_benchmark() {
+  const int NUM_QUERIES = 2000;
+  const int DEPTHS[] = {30, 50};
+
+  std::cout << "\n========================================\n";
+  std::cout << "   BFS PATH QUERY BENCHMARK\n";
+  std::cout << "   " << NUM_QUERIES << " queries between surface cells\n";
+  std::cout << "========================================\n\n";
+
+  World world;
+  auto standing_cell = [&](int x) {
+    Coord c = {x, 0};
+    while (c.y < CHUNK_SIZE - 1 and
+           (world.get_block(c.x, c.y) != BlockType::AIR or
+            world.get_block(c.x, c.y + 1) == BlockType::AIR))
+      ++c.y;
+    return c;
+  };
+
+  seed_fast_rand(4242);
+  std::vector<std::pair<Coord, Coord>> queries;
+  for (int i = 0; i < NUM_QUERIES; i++) {
+    int x = static_cast<int>(fast_rand() % 200) - 100;
+    int dx = static_cast<int>(fast_rand() % 41) - 20;
+    queries.push_back({standing_cell(x), standing_cell(x + dx)});
+  }
+
+  for (int depth : DEPTHS) {
+    size_t found_legacy = 0, found_context = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto [from, to] : queries) {
+      found_legacy += !bfs_findpath(from, to, world, depth).empty();
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    PathContext context(depth);
+    for (auto [from, to] : queries) {
+      found_context += !context.find_path(from, to, world, depth).empty();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double legacy_s = std::chrono::duration<double>(mid - start).count();
+    double context_s = std::chrono::duration<double>(end - mid).count();
+    std::cout << "Depth " << depth << ": bfs_findpath "
+              << NUM_QUERIES / legacy_s << " paths/s, PathContext "
+              << NUM_QUERIES / context_s << " paths/s ("
+              << legacy_s / context_s << "x, " << found_context << "/"
+              << found_legacy << " found)\n";
+  }
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_astar_benchmark() {
+  const int NUM_QUERIES = 500;
+  const int MAX_STEPS = 90;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   LONG-RANGE PATHFINDING BENCHMARK\n";
+  std::cout << "   " << NUM_QUERIES << " queries, 20-80 blocks apart, up to "
+            << MAX_STEPS << " moves\n";
+  std::cout << "========================================\n\n";
+
+  // Natural terrain is cut up by trees a mob can't climb, so long paths are
+  // rare there. Carve an open cave instead: a stone floor at FLOOR_Y with
+  // 1- and 2-block steps and pillars, which mobs can cross.
+  const int FLOOR_Y = 24;
+  const int ARENA_X0 = -160, ARENA_X1 = 160;
+  World world;
+  seed_fast_rand(99);
+  for (int x = ARENA_X0; x <= ARENA_X1; x++) {
+    for (int y = 8; y < FLOOR_Y; y++)
+      world.set_block(x, y, BlockType::AIR);
+    world.set_block(x, FLOOR_Y, BlockType::STONE);
+    uint32_t r = fast_rand() % 16;
+    int height = r == 0 ? 2 : r < 3 ? 1 : 0;
+    for (int h = 1; h <= height; h++)
+      world.set_block(x, FLOOR_Y - h, BlockType::STONE);
+  }
+  auto standing_cell = [&](int x) {
+    Coord c = {x, 8};
+    while (world.get_block(c.x, c.y + 1) == BlockType::AIR)
+      ++c.y;
+    return c;
+  };
+
+  std::vector<std::pair<Coord, Coord>> queries;
+  for (int i = 0; i < NUM_QUERIES; i++) {
+    int x = static_cast<int>(fast_rand() % 160) - 80;
+    int dx = 20 + static_cast<int>(fast_rand() % 61);
+    if (fast_rand() & 1)
+      dx = -dx;
+    queries.push_back({standing_cell(x), standing_cell(x + dx)});
+  }
+
+  struct Result {
+    double paths_per_s;
+    double expanded_per_query;
+    size_t found;
+    size_t total_length;
+  };
+  auto measure = [&](auto &&search, auto &&expanded) {
+    size_t found = 0, length = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto [from, to] : queries) {
+      size_t n = search(from, to).size();
+      found += n > 0;
+      length += n;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double s = std::chrono::duration<double>(end - start).count();
+    return Result{NUM_QUERIES / s,
+                  static_cast<double>(expanded()) / NUM_QUERIES, found,
+                  length};
+  };
+
+  PathContext bfs(MAX_STEPS);
+  Result r_bfs = measure(
+      [&](Coord a, Coord b) -> const std::vector<Coord> & {
+        return bfs.find_path(a, b, world, MAX_STEPS);
+      },
+      [&] { return bfs.nodes_expanded(); });
+
+  AStarPathfinder astar(MAX_STEPS);
+  Result r_astar = measure(
+      [&](Coord a, Coord b) -> const std::vector<Coord> & {
+        return astar.find_path(a, b, world, MAX_STEPS);
+      },
+      [&] { return astar.stats().nodes_expanded; });
+
+  AStarPathfinder jps(MAX_STEPS);
+  jps.set_jump_points(true);
+  Result r_jps = measure(
+      [&](Coord a, Coord b) -> const std::vector<Coord> & {
+        return jps.find_path(a, b, world, MAX_STEPS);
+      },
+      [&] { return jps.stats().nodes_expanded; });
+
+  auto print = [&](const char *name, const Result &r) {
+    std::cout << name << r.paths_per_s << " paths/s, "
+              << r.expanded_per_query << " nodes expanded/query, " << r.found
+              << " found, avg length "
+              << (r.found ? static_cast<double>(r.total_length) / r.found : 0)
+              << "\n";
+  };
+  print("BFS:          ", r_bfs);
+  print("A*:           ", r_astar);
+  print("A* + jumps:   ", r_jps);
+  std::cout << "Speedup over BFS: A* "
+            << r_astar.paths_per_s / r_bfs.paths_per_s << "x, with jumps "
+            << r_jps.paths_per_s / r_bfs.paths_per_s << "x\n";
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_mob_grid_benchmark() {
+  const int MOB_COUNTS[] = {100, 1000, 10000, 100000};
+  const int NUM_QUERIES = 1000;
+  const int WORLD_WIDTH = 4096;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   MOB SPATIAL INDEX BENCHMARK\n";
+  std::cout << "   mobs spread over " << WORLD_WIDTH << " x " << CHUNK_SIZE
+            << " blocks; viewport and radius-60 queries\n";
+  std::cout << "========================================\n\n";
+
+  for (int count : MOB_COUNTS) {
+    seed_fast_rand(31337);
+    MobStorage mobs;
+    for (int i = 0; i < count; i++) {
+      mobs.add(static_cast<int>(fast_rand() % WORLD_WIDTH) - WORLD_WIDTH / 2,
+               static_cast<int>(fast_rand() % CHUNK_SIZE), 20,
+               MobType::ZOMBIE, AIState::CHASING);
+    }
+    std::vector<Coord> centers;
+    for (int q = 0; q < NUM_QUERIES; q++) {
+      centers.push_back(
+          {static_cast<int>(fast_rand() % WORLD_WIDTH) - WORLD_WIDTH / 2,
+           static_cast<int>(fast_rand() % CHUNK_SIZE)});
+    }
+
+    size_t hits_scan = 0, hits_grid = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (Coord c : centers) {
+      for (size_t i = 0; i < mobs.count(); i++) {
+        int sx = mobs.x[i] - (c.x - 40);
+        int sy = mobs.y[i] - (c.y - 12);
+        hits_scan += sx >= 0 and sx < 80 and sy >= 0 and sy < 24;
+        int dx = mobs.x[i] - c.x;
+        int dy = mobs.y[i] - c.y;
+        hits_scan += dx * dx + dy * dy <= 3600;
+      }
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (Coord c : centers) {
+      mobs.grid.query(c.x - 40, c.y - 12, c.x + 39, c.y + 11,
+                      [&](size_t) { hits_grid++; });
+      mobs.grid.query_radius(c, 60, [&](size_t) { hits_grid++; });
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // Every mob takes one step, through set_pos (keeps the grid current).
+    const int MOVE_ROUNDS = 10;
+    auto t3 = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < MOVE_ROUNDS; r++) {
+      int step = (r & 1) ? -1 : 1;
+      for (size_t i = 0; i < mobs.count(); i++) {
+        mobs.set_pos(i, {mobs.x[i] + step, mobs.y[i]});
+      }
+    }
+    auto t4 = std::chrono::high_resolution_clock::now();
+
+    auto us = [](auto a, auto b) {
+      return std::chrono::duration<double, std::micro>(b - a).count();
+    };
+    double scan_us = us(t0, t1) / NUM_QUERIES;
+    double grid_us = us(t1, t2) / NUM_QUERIES;
+    std::cout << count << " mobs: scan " << scan_us << " us, grid " << grid_us
+              << " us per frame's queries (" << scan_us / grid_us
+              << "x); set_pos " << us(t3, t4) * 1000.0 / MOVE_ROUNDS / count
+              << " ns/mob" << (hits_scan == hits_grid ? "" : " MISMATCH")
+              << "\n";
+  }
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_sim_tier_benchmark() {
+  const int MOB_COUNTS[] = {1000, 10000, 100000};
+  const int WORLD_WIDTH = 8192;
+  const int WARMUP_MOVES = 8;
+  const int TIMED_MOVES = 32;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   TIERED MOB SIMULATION BENCHMARK\n";
+  std::cout << "   mobs over " << WORLD_WIDTH << " blocks, " << TIMED_MOVES
+            << " mob moves each\n";
+  std::cout << "========================================\n\n";
+
+  for (int count : MOB_COUNTS) {
+    seed_fast_rand(4242);
+    World world;
+    int player_x = 0, player_y = 0, facing = 1, selected = 1;
+    int inventory[9] = {0};
+    while (world.get_block(player_x, player_y + 1) == BlockType::AIR)
+      ++player_y;
+    GameWindow game(world, player_x, player_y, facing, inventory, selected);
+    MobStorage &mobs = game.get_mobs();
+    for (int i = 0; i < count; i++) {
+      mobs.add(static_cast<int>(fast_rand() % WORLD_WIDTH) - WORLD_WIDTH / 2,
+               static_cast<int>(fast_rand() % CHUNK_SIZE), 20,
+               MobType::ZOMBIE, AIState::CHASING);
+    }
+
+    // One mob move per call; the warmup generates the chunks on screen.
+    for (int m = 0; m < WARMUP_MOVES; m++)
+      game.update(0.5);
+
+    double total_ms = 0, worst_ms = 0;
+    for (int m = 0; m < TIMED_MOVES; m++) {
+      auto start = std::chrono::high_resolution_clock::now();
+      game.update(0.5);
+      auto end = std::chrono::high_resolution_clock::now();
+      double ms =
+          std::chrono::duration<double, std::milli>(end - start).count();
+      total_ms += ms;
+      worst_ms = std::max(worst_ms, ms);
+    }
+
+    std::cout << count << " mobs (view "
+              << mobs.mobs_in(SimTier::VIEW).size() << ", mid "
+              << mobs.mobs_in(SimTier::MID).size() << ", far "
+              << mobs.mobs_in(SimTier::FAR).size()
+              << "): " << total_ms / TIMED_MOVES << " ms per move, worst "
+              << worst_ms << " ms\n";
+  }
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_parallel_ai_benchmark() {
+  const int NUM_MOBS = 100000;
+  const int WORLD_WIDTH = 8192;
+  const int WARMUP_MOVES = 8;
+  const int TIMED_MOVES = 32;
+  const unsigned THREAD_COUNTS[] = {0, 1, 2, 4};
+
+  std::cout << "\n========================================\n";
+  std::cout << "   PARALLEL MOB AI BENCHMARK\n";
+  std::cout << "   " << NUM_MOBS << " mobs, " << TIMED_MOVES
+            << " mob moves per thread count ("
+            << std::thread::hardware_concurrency() << " cores)\n";
+  std::cout << "========================================\n\n";
+
+  double serial_ms = 0;
+  for (unsigned threads : THREAD_COUNTS) {
+    seed_fast_rand(4242);
+    World world;
+    int player_x = 0, player_y = 0, facing = 1, selected = 1;
+    int inventory[9] = {0};
+    while (world.get_block(player_x, player_y + 1) == BlockType::AIR)
+      ++player_y;
+    GameWindow game(world, player_x, player_y, facing, inventory, selected);
+    game.set_ai_threads(threads);
+    MobStorage &mobs = game.get_mobs();
+    for (int i = 0; i < NUM_MOBS; i++) {
+      mobs.add(static_cast<int>(fast_rand() % WORLD_WIDTH) - WORLD_WIDTH / 2,
+               static_cast<int>(fast_rand() % CHUNK_SIZE), 20,
+               MobType::ZOMBIE, AIState::CHASING);
+    }
+    for (int m = 0; m < WARMUP_MOVES; m++)
+      game.update(0.5);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int m = 0; m < TIMED_MOVES; m++)
+      game.update(0.5);
+    auto end = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count() /
+                TIMED_MOVES;
+    if (threads == 0)
+      serial_ms = ms;
+
+    std::cout << (threads == 0 ? std::string("serial")
+                               : std::to_string(threads) + " threads")
+              << ": " << ms << " ms per move";
+    if (threads > 0)
+      std::cout << " (" << serial_ms / ms << "x serial)";
+    std::cout << "\n";
+  }
+
+  std::cout << "\n========================================\n\n";
+}
+
+inline void run_mob_kernels_benchmark() {
+  const int NUM_MOBS = 100000;
+  const int NUM_ROUNDS = 200;
+  const int RADIUS = 40;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   MOB BULK KERNEL BENCHMARK\n";
+  std::cout << "   " << NUM_MOBS << " mobs, damage-in-radius + cull-dead x "
+            << NUM_ROUNDS << "\n";
+  std::cout << "========================================\n\n";
+
+  // The previous layout: one std::vector<int> per field.
+  struct VectorColumns {
+    std::vector<int> x, y, hp;
+  } plain;
+
+  seed_fast_rand(777);
+  MobStorage mobs;
+  mobs.reserve(NUM_MOBS);
+  for (int i = 0; i < NUM_MOBS; i++) {
+    int mx = static_cast<int>(fast_rand() % 8192) - 4096;
+    int my = static_cast<int>(fast_rand() % CHUNK_SIZE);
+    mobs.add(mx, my, 30000, MobType::ZOMBIE, AIState::CHASING);
+    plain.x.push_back(mx);
+    plain.y.push_back(my);
+    plain.hp.push_back(30000);
+  }
+
+  // Same centers for both; hp is high enough that nobody dies, so both
+  // sides do the same work every round.
+  std::vector<Coord> centers;
+  for (int r = 0; r < NUM_ROUNDS; r++) {
+    centers.push_back({static_cast<int>(fast_rand() % 8192) - 4096,
+                       static_cast<int>(fast_rand() % CHUNK_SIZE)});
+  }
+
+  size_t plain_hits = 0;
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (Coord c : centers) {
+    for (size_t i = 0; i < plain.x.size(); i++) {
+      int dx = plain.x[i] - c.x;
+      int dy = plain.y[i] - c.y;
+      if (dx * dx + dy * dy <= RADIUS * RADIUS) {
+        plain.hp[i] = std::max(0, plain.hp[i] - 1);
+        plain_hits++;
+      }
+    }
+    for (size_t i = plain.hp.size(); i-- > 0;) {
+      if (plain.hp[i] <= 0) {
+        plain.x[i] = plain.x.back();
+        plain.y[i] = plain.y.back();
+        plain.hp[i] = plain.hp.back();
+        plain.x.pop_back();
+        plain.y.pop_back();
+        plain.hp.pop_back();
+      }
+    }
+  }
+  auto t1 = std::chrono::high_resolution_clock::now();
+
+  size_t kernel_hits = 0;
+  for (Coord c : centers) {
+    kernel_hits += mobs.damage_in_radius(c, RADIUS, 1);
+    mobs.cull_dead();
+  }
+  auto t2 = std::chrono::high_resolution_clock::now();
+
+  auto us = [](auto a, auto b) {
+    return std::chrono::duration<double, std::micro>(b - a).count();
+  };
+  double plain_us = us(t0, t1) / NUM_ROUNDS;
+  double kernel_us = us(t1, t2) / NUM_ROUNDS;
+  std::cout << "vector<int> columns: " << plain_us << " us/round\n";
+  std::cout << "Aligned columns:     " << kernel_us << " us/round ("
+            << plain_us / kernel_us << "x)"
+            << (plain_hits == kernel_hits ? "" : " MISMATCH") << "\n";
+  std::cout << "Hits per round:      " << kernel_hits / NUM_ROUNDS << "\n";
+
+  std::cout << "\n========================================\n\n";
+}
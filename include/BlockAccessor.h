@@ -0,0 +1,135 @@
+#pragma once
+#include "BlockType.h"
+#include "Chunk.h"
+#include "Coord.h"
+#include "World.h"
+#include <utility>
+
+// Read-only window onto one resident chunk, so a loop over a 32x32 region
+// does no hashing and no bounds checks.
+class ChunkView {
+private:
+  const Chunk *chunk = nullptr;
+
+public:
+  ChunkView() = default;
+  explicit ChunkView(const Chunk *c) : chunk(c) {}
+
+  bool valid() const { return chunk != nullptr; }
+
+  // World coordinates of local (0, 0).
+  int origin_x() const { return chunk->get_position().x * CHUNK_SIZE; }
+  int origin_y() const { return chunk->get_position().y * CHUNK_SIZE; }
+
+  // Unchecked: 0 <= ly < CHUNK_SIZE, and the view must be valid. `out`
+  // gets CHUNK_SIZE blocks.
+  void read_row(int ly, BlockType *out) const {
+    chunk->read_row(ly, 0, CHUNK_SIZE, out);
+  }
+  BlockType at(int lx, int ly) const { return chunk->at(lx, ly); }
+};
+
+// Block lookups that remember the last two chunks they resolved. Nearly all
+// lookups in a loop land in the chunk of the previous one (or its neighbour
+// across a border), so they skip the table probe entirely.
+//
+// Meant to live for one loop or one frame: the cached pointers are only
+// valid while the world does not drop chunks.
+class BlockAccessor {
+private:
+  World &world;
+  Coord keys[2];
+  const Chunk *cached[2] = {nullptr, nullptr};
+
+public:
+  explicit BlockAccessor(World &w) : world(w) {}
+
+  BlockType get_block(int wx, int wy) {
+    const Chunk &chunk = resolve(World::world_to_chunk(wx, wy));
+    return chunk.at(World::local_coord(wx), World::local_coord(wy));
+  }
+
+  // Edits go through World so its bookkeeping stays in one place; the
+  // cached chunk pointers stay valid.
+  void set_block(int wx, int wy, BlockType type) {
+    world.set_block(wx, wy, type);
+  }
+
+  // Non-blocking, like World::peek_block: false if the chunk isn't resident.
+  bool peek_block(int wx, int wy, BlockType &out) {
+    const Chunk *chunk = peek(World::world_to_chunk(wx, wy));
+    if (!chunk)
+      return false;
+    out = chunk->at(World::local_coord(wx), World::local_coord(wy));
+    return true;
+  }
+
+  ChunkView view(Coord chunk_pos) { return ChunkView(&resolve(chunk_pos)); }
+
+  // Invalid view if the chunk isn't resident yet.
+  ChunkView peek_view(Coord chunk_pos) { return ChunkView(peek(chunk_pos)); }
+
+private:
+  const Chunk *lookup(Coord pos) {
+    if (cached[0] and keys[0] == pos)
+      return cached[0];
+    if (cached[1] and keys[1] == pos) {
+      std::swap(keys[0], keys[1]);
+      std::swap(cached[0], cached[1]);
+      return cached[0];
+    }
+    return nullptr;
+  }
+
+  void remember(Coord pos, const Chunk *chunk) {
+    keys[1] = keys[0];
+    cached[1] = cached[0];
+    keys[0] = pos;
+    cached[0] = chunk;
+  }
+
+  const Chunk &resolve(Coord pos) {
+    if (const Chunk *hit = lookup(pos))
+      return *hit;
+    const Chunk &chunk = world.get_chunk(pos);
+    remember(pos, &chunk);
+    return chunk;
+  }
+
+  const Chunk *peek(Coord pos) {
+    if (const Chunk *hit = lookup(pos))
+      return hit;
+    const Chunk *chunk = world.peek_chunk(pos);
+    if (chunk)
+      remember(pos, chunk);
+    return chunk;
+  }
+};
+
+// Lookups over resident chunks only, through World::find_chunk: blocks of
+// chunks that aren't loaded read as UNLOADED_BLOCK (not AIR, so mobs treat
+// them as solid). Never touches the world, so any number of these can read
+// in parallel while the main thread holds the world still.
+class ResidentBlocks {
+private:
+  const World &world;
+  Coord key;
+  const Chunk *cached = nullptr;
+
+public:
+  explicit ResidentBlocks(const World &w) : world(w) {}
+
+  BlockType get_block(int wx, int wy) {
+    Coord pos = World::world_to_chunk(wx, wy);
+    if (!cached or !(key == pos)) {
+      const Chunk *chunk = world.find_chunk(pos);
+      if (!chunk)
+        return UNLOADED_BLOCK;
+      key = pos;
+      cached = chunk;
+    }
+    return cached->at(World::local_coord(wx), World::local_coord(wy));
+  }
+
+  BlockType operator()(int wx, int wy) { return get_block(wx, wy); }
+};
@@ -68,4 +68,9 @@ inline std::string block_to_string(BlockType b) {
   default:
     return "Unknown";
   }
-}
\ No newline at end of file
+}
+
+inline bool is_ore(BlockType b) {
+  return b == BlockType::IRON or b == BlockType::GOLD or
+         b == BlockType::DIAMOND;
+}
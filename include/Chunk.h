@@ -1,36 +1,248 @@
 #pragma once
 #include "BlockType.h"
 #include "Coord.h"
+#include "PackedBlocks.h"
 #include "Pixel.h"
 #include "Terrain.h"
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <span>
+#include <vector>
 
+static_assert(CHUNK_SIZE == 32, "exposure masks hold one row in a uint32_t");
+
+// Blocks are kept packed (see PackedBlocks) until the first edit, which
+// unpacks them into a flat array for as long as the chunk keeps changing;
+// pack() folds a clean chunk back. Reads work the same in both forms.
 class Chunk {
-  std::array<std::array<BlockType, CHUNK_SIZE>, CHUNK_SIZE> blocks;
   Coord position;
+  PackedBlocks packed;
+  // While unpacked: the blocks, and bit x of dirty[y] per cell edited since
+  // the last clear_dirty. Shared with saves in progress (see share_blocks)
+  // and copied on the next edit while it is.
+  struct Unpacked {
+    ChunkBlocks blocks;
+    std::array<uint32_t, CHUNK_SIZE> dirty = {};
+  };
+  std::shared_ptr<Unpacked> flat;
+  // Bit x of exposed[y]: (x, y) is an ore with AIR on at least one side.
+  std::array<uint32_t, CHUNK_SIZE> exposed;
+  // Bit y per row with edits since the last clear_dirty. mod_count counts
+  // every edit ever.
+  uint32_t dirty_rows = 0;
+  uint32_t mod_count = 0;
+  // World frame this chunk was last handed out in, for LRU eviction.
+  uint32_t used_frame = 0;
+  // Journal number of the last edit World made here (see note_edit).
+  uint64_t edit_number = 0;
+  // Running total this chunk's memory_bytes() is counted in, if any.
+  size_t *memory_total = nullptr;
 
 public:
-  Chunk(Coord pos) : position(pos) { generate_terrain(); }
+  Chunk(Coord pos, int bedrock_y = DEFAULT_BEDROCK_Y) : position(pos) {
+    ChunkBlocks blocks;
+    generate_chunk_terrain(blocks, position.x, position.y, TERRAIN_SEED,
+                           bedrock_y);
+    packed.pack(blocks);
+    refresh_exposure(0, CHUNK_SIZE - 1, nullptr, nullptr, nullptr, nullptr);
+  }
+
+  // A saved chunk, from PackedBlocks bytes that passed PackedBlocks::valid.
+  Chunk(Coord pos, std::span<const uint8_t> saved) : position(pos) {
+    packed.assign(saved);
+    refresh_exposure(0, CHUNK_SIZE - 1, nullptr, nullptr, nullptr, nullptr);
+  }
 
   BlockType get_block(int xx, int yy) const {
     if (xx < 0 or xx >= CHUNK_SIZE or yy < 0 or yy >= CHUNK_SIZE) {
       return BlockType::AIR;
     }
-    return blocks[yy][xx];
+    return at(xx, yy);
+  }
+
+  // Unchecked: 0 <= xx, yy < CHUNK_SIZE.
+  BlockType at(int xx, int yy) const {
+    return flat ? flat->blocks[yy][xx] : packed.get(xx, yy);
   }
 
+  // Blocks xx .. xx + n - 1 of row yy into `out`. Unchecked.
+  void read_row(int yy, int xx, int n, BlockType *out) const {
+    if (flat) {
+      std::copy_n(flat->blocks[yy].data() + xx, n, out);
+    } else {
+      packed.read_row(yy, xx, n, out);
+    }
+  }
+
+  // Raw write: does not touch the exposure mask. World::set_block is the
+  // edit path that keeps it (and the neighbouring chunks' masks) current.
+  // Writing the block that is already there is not an edit.
   void set_block(int xx, int yy, BlockType type) {
     if (xx < 0 or xx >= CHUNK_SIZE or yy < 0 or yy >= CHUNK_SIZE) {
       return;
     }
-    blocks[yy][xx] = type;
+    if (at(xx, yy) == type)
+      return;
+    unpack();
+    if (flat.use_count() > 1)
+      flat = std::make_shared<Unpacked>(*flat);
+    flat->blocks[yy][xx] = type;
+    flat->dirty[yy] |= 1u << xx;
+    dirty_rows |= 1u << yy;
+    ++mod_count;
+  }
+
+  void unpack() {
+    if (flat)
+      return;
+    size_t before = memory_bytes();
+    flat = std::make_shared<Unpacked>();
+    packed.unpack(flat->blocks);
+    packed = PackedBlocks();
+    recount_memory(before);
+  }
+
+  // Back to the packed form. Only a clean chunk is packed (its dirty bits
+  // live in the flat form); returns whether it is packed now.
+  bool pack() {
+    if (flat and dirty_rows == 0) {
+      size_t before = memory_bytes();
+      packed.pack(flat->blocks);
+      flat.reset();
+      recount_memory(before);
+    }
+    return !flat;
+  }
+
+  // pack() with the blocks already packed elsewhere (a save packs them):
+  // `blocks` must hold this chunk's current blocks.
+  bool pack(PackedBlocks &&blocks) {
+    if (flat and dirty_rows == 0) {
+      size_t before = memory_bytes();
+      packed = std::move(blocks);
+      flat.reset();
+      recount_memory(before);
+    }
+    return !flat;
+  }
+
+  bool is_packed() const { return !flat; }
+
+  // The blocks as they are now, without copying them if the chunk is
+  // unpacked: later edits copy them first instead. Edits tell from
+  // use_count(), which doesn't order other threads' reads before it, so
+  // drop the share on the thread that edits the chunk.
+  std::shared_ptr<const ChunkBlocks> share_blocks() const {
+    if (flat)
+      return {flat, &flat->blocks};
+    auto copy = std::make_shared<ChunkBlocks>();
+    packed.unpack(*copy);
+    return copy;
   }
 
+  // The blocks in the PackedBlocks save format, appended to `out`.
+  void encode(std::vector<uint8_t> &out) const {
+    if (flat) {
+      PackedBlocks::encode(flat->blocks, out);
+    } else {
+      std::span<const uint8_t> bytes = packed.data();
+      out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+  }
+
+  // Heap and object bytes this chunk holds.
+  size_t memory_bytes() const {
+    return sizeof(Chunk) + packed.heap_bytes() +
+           (flat ? sizeof(Unpacked) : 0);
+  }
+
+  // Add memory_bytes() to *total now, and keep it current as the chunk is
+  // packed and unpacked. Whoever drops the chunk takes it out again.
+  void count_memory_in(size_t *total) {
+    memory_total = total;
+    *total += memory_bytes();
+  }
+
+  uint32_t modification_count() const { return mod_count; }
+  void note_edit(uint64_t journal_number) { edit_number = journal_number; }
+  uint64_t last_edit() const { return edit_number; }
+  bool is_dirty() const { return dirty_rows != 0; }
+  // Bit y set where row y has edits; bit x of dirty_row(y) per edited cell.
+  uint32_t dirty_row_mask() const { return dirty_rows; }
+  uint32_t dirty_row(int yy) const { return flat ? flat->dirty[yy] : 0; }
+
+  // Called once the edits have been dealt with (e.g. saved).
+  void clear_dirty() {
+    if (flat)
+      flat->dirty.fill(0);
+    dirty_rows = 0;
+  }
+
+  // Unchecked: 0 <= xx, yy < CHUNK_SIZE.
+  bool is_exposed(int xx, int yy) const { return (exposed[yy] >> xx) & 1u; }
+  uint32_t exposed_row(int yy) const { return exposed[yy]; }
+
+  // Bit x set where row yy is AIR.
+  uint32_t air_row(int yy) const {
+    return row_mask(yy, [](BlockType b) { return b == BlockType::AIR; });
+  }
+
+  // Recompute exposure for rows y0..y1 (clamped). Neighbouring chunks that
+  // aren't loaded are passed as nullptr and count as solid.
+  void refresh_exposure(int y0, int y1, const Chunk *left, const Chunk *right,
+                        const Chunk *above, const Chunk *below) {
+    y0 = y0 < 0 ? 0 : y0;
+    y1 = y1 >= CHUNK_SIZE ? CHUNK_SIZE - 1 : y1;
+    for (int y = y0; y <= y1; ++y) {
+      uint32_t ore = row_mask(y, is_ore);
+      if (ore == 0) {
+        exposed[y] = 0;
+        continue;
+      }
+      uint32_t air = air_row(y);
+      uint32_t open = (air << 1) | (air >> 1);
+      if (left and left->at(CHUNK_SIZE - 1, y) == BlockType::AIR)
+        open |= 1u;
+      if (right and right->at(0, y) == BlockType::AIR)
+        open |= 1u << (CHUNK_SIZE - 1);
+      if (y > 0)
+        open |= air_row(y - 1);
+      else if (above)
+        open |= above->air_row(CHUNK_SIZE - 1);
+      if (y < CHUNK_SIZE - 1)
+        open |= air_row(y + 1);
+      else if (below)
+        open |= below->air_row(0);
+      exposed[y] = ore & open;
+    }
+  }
+
+  void touch(uint32_t frame) { used_frame = frame; }
+  uint32_t last_use() const { return used_frame; }
+
   Coord get_position() const { return position; }
 
 private:
-  void generate_terrain() { generate_chunk_terrain(blocks, position.x); }
+  void recount_memory(size_t before) {
+    if (memory_total)
+      *memory_total += memory_bytes() - before;
+  }
+
+  // Bit x set where pred(block (x, yy)); a uniform packed row is one test.
+  template <typename Pred> uint32_t row_mask(int yy, Pred pred) const {
+    if (!flat and packed.is_uniform_row(yy))
+      return pred(packed.get(0, yy)) ? ~0u : 0u;
+    BlockType row[CHUNK_SIZE];
+    read_row(yy, 0, CHUNK_SIZE, row);
+    uint32_t mask = 0;
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+      mask |= static_cast<uint32_t>(pred(row[x])) << x;
+    }
+    return mask;
+  }
 };
 
 inline void print_chunk(const Chunk &chunk) {
@@ -41,4 +253,4 @@ inline void print_chunk(const Chunk &chunk) {
     }
     std::cout << "\n";
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "Chunk.h"
+#include "Coord.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// Generates chunks on a WorkStealingPool. Only the main thread calls into the
+// provider; workers just build the Chunk and hand it back through `ready`.
+// The pool is started lazily on the first request, so a World that never
+// prefetches never spawns threads.
+class ChunkProvider {
+private:
+  std::unique_ptr<WorkStealingPool> pool;
+  std::unordered_set<Coord, CoordHash> in_flight;
+
+  std::mutex ready_mutex;
+  std::condition_variable ready_cv;
+  std::vector<std::unique_ptr<Chunk>> ready;
+
+  size_t requested = 0;
+  int bedrock_y = DEFAULT_BEDROCK_Y;
+
+public:
+  ~ChunkProvider() {
+    // Join the workers before `ready` and the mutex go away.
+    pool.reset();
+  }
+
+  // Queue generation of `pos`. Returns false if it is already queued.
+  bool request(Coord pos) {
+    if (!in_flight.insert(pos).second)
+      return false;
+    if (!pool)
+      pool = std::make_unique<WorkStealingPool>();
+    ++requested;
+    pool->submit([this, pos, floor = bedrock_y] {
+      auto chunk = std::make_unique<Chunk>(pos, floor);
+      {
+        std::lock_guard<std::mutex> lock(ready_mutex);
+        ready.push_back(std::move(chunk));
+      }
+      ready_cv.notify_all();
+    });
+    return true;
+  }
+
+  // Generation setting for chunks requested from now on.
+  void set_bedrock_y(int wy) { bedrock_y = wy; }
+
+  bool is_pending(Coord pos) const { return in_flight.count(pos) != 0; }
+
+  size_t pending_count() const { return in_flight.size(); }
+
+  size_t requested_count() const { return requested; }
+
+  // Hand every finished chunk to `sink(std::unique_ptr<Chunk>)`.
+  template <typename Sink> void drain(Sink &&sink) {
+    std::vector<std::unique_ptr<Chunk>> done;
+    {
+      std::lock_guard<std::mutex> lock(ready_mutex);
+      if (ready.empty())
+        return;
+      done.swap(ready);
+    }
+    for (auto &chunk : done) {
+      in_flight.erase(chunk->get_position());
+      sink(std::move(chunk));
+    }
+  }
+
+  // Block until `pos` (which must be pending) is finished. Everything that
+  // finished in the meantime is drained into `sink` as well, `pos` included.
+  template <typename Sink> void wait_for(Coord pos, Sink &&sink) {
+    while (is_pending(pos)) {
+      {
+        std::unique_lock<std::mutex> lock(ready_mutex);
+        ready_cv.wait(lock, [this] { return !ready.empty(); });
+      }
+      drain(sink);
+    }
+  }
+};
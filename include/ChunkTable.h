@@ -0,0 +1,240 @@
+#pragma once
+#include "Chunk.h"
+#include "Coord.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Open-addressing map from a packed 64-bit key (see pack_coord) to a small
+// value type. Linear probing over a flat power-of-two slot array,
+// backward-shift deletion (no tombstones), grows at 70% load. EMPTY marks a
+// free slot and cannot be stored as a value.
+//
+// Slots are found with Fibonacci hashing: one multiply, then the top bits.
+// x sits in the high half of the key and y in the low half, so both reach the
+// top bits after the multiply.
+template <typename V, V EMPTY> class FlatKeyTable {
+public:
+  V find(uint64_t key) const {
+    if (slots.empty())
+      return EMPTY;
+    size_t i = home(key);
+    while (true) {
+      const Slot &s = slots[i];
+      if (s.value == EMPTY or s.key == key)
+        return s.value;
+      i = (i + 1) & mask;
+    }
+  }
+
+  // Inserts or overwrites.
+  void insert(uint64_t key, V value) {
+    if ((used + 1) * 10 > slots.size() * 7)
+      grow();
+    size_t i = home(key);
+    while (slots[i].value != EMPTY) {
+      if (slots[i].key == key) {
+        slots[i].value = value;
+        return;
+      }
+      i = (i + 1) & mask;
+    }
+    slots[i] = {key, value};
+    ++used;
+  }
+
+  bool erase(uint64_t key) {
+    if (slots.empty())
+      return false;
+    size_t i = home(key);
+    while (slots[i].key != key or slots[i].value == EMPTY) {
+      if (slots[i].value == EMPTY)
+        return false;
+      i = (i + 1) & mask;
+    }
+    // Shift later members of the probe run back into the hole.
+    size_t hole = i;
+    size_t j = i;
+    while (true) {
+      j = (j + 1) & mask;
+      if (slots[j].value == EMPTY)
+        break;
+      if (((j - home(slots[j].key)) & mask) >= ((j - hole) & mask)) {
+        slots[hole] = slots[j];
+        hole = j;
+      }
+    }
+    slots[hole].value = EMPTY;
+    --used;
+    return true;
+  }
+
+  size_t size() const { return used; }
+
+  void clear() {
+    slots.clear();
+    mask = 0;
+    shift = 64;
+    used = 0;
+  }
+
+  // f(key, value) for every entry, in slot order.
+  template <typename F> void for_each(F &&f) const {
+    for (const Slot &s : slots) {
+      if (s.value != EMPTY)
+        f(s.key, s.value);
+    }
+  }
+
+private:
+  struct Slot {
+    uint64_t key = 0;
+    V value = EMPTY;
+  };
+
+  std::vector<Slot> slots;
+  size_t mask = 0;
+  int shift = 64;
+  size_t used = 0;
+
+  size_t home(uint64_t key) const {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+  }
+
+  void grow() {
+    std::vector<Slot> old = std::move(slots);
+    size_t cap = old.empty() ? 64 : old.size() * 2;
+    slots.assign(cap, Slot{});
+    mask = cap - 1;
+    shift = 64;
+    for (size_t c = cap; c > 1; c >>= 1)
+      --shift;
+    used = 0;
+    for (const Slot &s : old) {
+      if (s.value != EMPTY)
+        insert(s.key, s.value);
+    }
+  }
+};
+
+// Fixed-size slabs of SLAB objects each. Objects never move once placed, and
+// neighbours in index order are neighbours in memory. Freed indices are
+// reused before new ones are handed out.
+template <typename T, size_t SLAB = 64> class SlabPool {
+public:
+  SlabPool() = default;
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+
+  ~SlabPool() {
+    for (uint32_t i = 0; i < live.size(); ++i) {
+      if (live[i])
+        get(i).~T();
+    }
+  }
+
+  template <typename... Args> uint32_t emplace(Args &&...args) {
+    uint32_t index;
+    if (!free_list.empty()) {
+      index = free_list.back();
+      free_list.pop_back();
+    } else {
+      index = static_cast<uint32_t>(live.size());
+      if (index % SLAB == 0)
+        slabs.push_back(std::make_unique<Storage[]>(SLAB));
+      live.push_back(0);
+    }
+    new (slot_ptr(index)) T(std::forward<Args>(args)...);
+    live[index] = 1;
+    return index;
+  }
+
+  void release(uint32_t index) {
+    get(index).~T();
+    live[index] = 0;
+    free_list.push_back(index);
+  }
+
+  T &get(uint32_t index) {
+    return *std::launder(reinterpret_cast<T *>(slot_ptr(index)));
+  }
+  const T &get(uint32_t index) const {
+    return *std::launder(reinterpret_cast<const T *>(
+        slabs[index / SLAB][index % SLAB].bytes));
+  }
+
+  size_t size() const { return live.size() - free_list.size(); }
+
+  // Bytes held by slabs, live or not.
+  size_t reserved_bytes() const { return slabs.size() * SLAB * sizeof(T); }
+
+  // f(index, object) for every live object, in memory order.
+  template <typename F> void for_each(F &&f) {
+    for (uint32_t i = 0; i < live.size(); ++i) {
+      if (live[i])
+        f(i, get(i));
+    }
+  }
+
+private:
+  struct Storage {
+    alignas(T) unsigned char bytes[sizeof(T)];
+  };
+
+  std::vector<std::unique_ptr<Storage[]>> slabs;
+  std::vector<uint8_t> live;
+  std::vector<uint32_t> free_list;
+
+  void *slot_ptr(uint32_t index) {
+    return slabs[index / SLAB][index % SLAB].bytes;
+  }
+};
+
+// Table value for ChunkTable: the chunk, plus its slot in the pool for erase.
+struct ChunkRef {
+  Chunk *chunk;
+  uint32_t index;
+
+  bool operator==(const ChunkRef &other) const { return chunk == other.chunk; }
+};
+
+// World's chunk storage: Chunks live in a SlabPool; a FlatKeyTable maps the
+// packed chunk coordinate straight to the Chunk, so a hit is one multiply,
+// a short probe and one pointer.
+class ChunkTable {
+public:
+  Chunk *find(Coord pos) const { return index_of.find(pack_coord(pos)).chunk; }
+
+  bool contains(Coord pos) const { return find(pos) != nullptr; }
+
+  // Constructs the chunk in place. `pos` must not be present yet.
+  template <typename... Args> Chunk &emplace(Coord pos, Args &&...args) {
+    uint32_t index = pool.emplace(std::forward<Args>(args)...);
+    Chunk &chunk = pool.get(index);
+    index_of.insert(pack_coord(pos), {&chunk, index});
+    return chunk;
+  }
+
+  bool erase(Coord pos) {
+    uint64_t key = pack_coord(pos);
+    ChunkRef ref = index_of.find(key);
+    if (!ref.chunk)
+      return false;
+    index_of.erase(key);
+    pool.release(ref.index);
+    return true;
+  }
+
+  size_t size() const { return index_of.size(); }
+
+  template <typename F> void for_each(F &&f) {
+    pool.for_each([&](uint32_t, Chunk &chunk) { f(chunk); });
+  }
+
+private:
+  FlatKeyTable<ChunkRef, ChunkRef{nullptr, 0}> index_of;
+  SlabPool<Chunk> pool;
+};
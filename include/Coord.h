@@ -1,5 +1,6 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 
@@ -25,10 +26,30 @@ inline std::ostream &operator<<(std::ostream &os, const Coord &coord) {
   return os;
 }
 
+// Both components in one 64-bit key: x in the high half, y in the low half.
+inline uint64_t pack_coord(Coord c) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32) |
+         static_cast<uint32_t>(c.y);
+}
+
+inline Coord unpack_coord(uint64_t key) {
+  return {static_cast<int>(static_cast<uint32_t>(key >> 32)),
+          static_cast<int>(static_cast<uint32_t>(key))};
+}
+
+// splitmix64 finalizer: every input bit affects every output bit, so nearby
+// chunk coordinates don't cluster in power-of-two tables.
+inline uint64_t mix64(uint64_t k) {
+  k ^= k >> 30;
+  k *= 0xbf58476d1ce4e5b9ull;
+  k ^= k >> 27;
+  k *= 0x94d049bb133111ebull;
+  k ^= k >> 31;
+  return k;
+}
+
 struct CoordHash {
   size_t operator()(const Coord &c) const {
-    size_t h1 = std::hash<int>{}(c.x);
-    size_t h2 = std::hash<int>{}(c.y);
-    return h1 ^ (h2 * 2654435761u);
+    return static_cast<size_t>(mix64(pack_coord(c)));
   }
 };
\ No newline at end of file
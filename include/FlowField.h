@@ -0,0 +1,135 @@
+#pragma once
+#include "BlockType.h"
+#include "Coord.h"
+#include "Pathfinding.h"
+#include "World.h"
+#include <cstdint>
+#include <vector>
+
+// Shortest-path distances to one target (the player) over a box around it,
+// shared by every mob chasing that target. Built with a single reverse BFS
+// using the same moves as bfs_findpath: cell p gets distance d + 1 from a
+// cell t at distance d when can_step allows p -> t. A mob then moves by
+// reading its own cell instead of running a search.
+//
+// All buffers are reused between builds; only growing the box allocates.
+class FlowField {
+private:
+  static constexpr uint16_t UNREACHED = 0xFFFF;
+  static constexpr uint8_t NO_STEP = 0xFF;
+  // Extra rows/columns copied around the box, for the checks can_step makes
+  // beside, above and up to 3 below a cell.
+  static constexpr int PAD_X = 1;
+  static constexpr int PAD_UP = 1;
+  static constexpr int PAD_DOWN = 3;
+
+  Coord target;
+  int x0 = 0, y0 = 0;
+  int width = 0, height = 0;
+  int max_dist = 0;
+
+  std::vector<BlockType> blocks; // (width + 2 PAD_X) x (height + pads)
+  std::vector<uint16_t> dist;    // width x height
+  std::vector<uint8_t> step;     // index into PATH_DIRS, per cell
+  std::vector<int> queue;
+
+  int padded_width() const { return width + 2 * PAD_X; }
+
+  BlockType block_at(int x, int y) const {
+    return blocks[(y - y0 + PAD_UP) * padded_width() + (x - x0 + PAD_X)];
+  }
+
+  int index_of(Coord c) const { return (c.y - y0) * width + (c.x - x0); }
+
+public:
+  // Cover the box of half-size radius_x by radius_y around `tar`, out to
+  // max_steps moves from it. Blocks on chunk generation like get_block.
+  void build(World &world, Coord tar, int radius_x, int radius_y,
+             int max_steps) {
+    target = tar;
+    x0 = tar.x - radius_x;
+    y0 = tar.y - radius_y;
+    width = 2 * radius_x + 1;
+    height = 2 * radius_y + 1;
+    max_dist = max_steps;
+
+    size_t cells = static_cast<size_t>(width) * height;
+    blocks.resize(static_cast<size_t>(padded_width()) *
+                  (height + PAD_UP + PAD_DOWN));
+    dist.assign(cells, UNREACHED);
+    step.assign(cells, NO_STEP);
+    queue.resize(cells);
+
+    world.copy_region(x0 - PAD_X, y0 - PAD_UP, padded_width(),
+                      height + PAD_UP + PAD_DOWN, blocks.data());
+
+    if (block_at(tar.x, tar.y) != BlockType::AIR)
+      return;
+
+    auto block = [this](int x, int y) { return block_at(x, y); };
+    size_t head = 0, tail = 0;
+    dist[index_of(tar)] = 0;
+    queue[tail++] = index_of(tar);
+
+    while (head < tail) {
+      int i = queue[head++];
+      Coord t = {x0 + i % width, y0 + i / width};
+      uint16_t d = dist[i];
+      if (d >= max_dist)
+        continue;
+
+      for (uint8_t k = 0; k < 6; ++k) {
+        Coord p = t - PATH_DIRS[k];
+        if (!contains(p))
+          continue;
+        int j = index_of(p);
+        if (dist[j] != UNREACHED or block_at(p.x, p.y) != BlockType::AIR)
+          continue;
+        if (!can_step(block, p, PATH_DIRS[k]))
+          continue;
+        dist[j] = d + 1;
+        step[j] = k;
+        queue[tail++] = j;
+      }
+    }
+  }
+
+  Coord get_target() const { return target; }
+
+  bool contains(Coord c) const {
+    return c.x >= x0 and c.x < x0 + width and c.y >= y0 and c.y < y0 + height;
+  }
+
+  // Moves from `from` to the target, or -1 if it can't be reached inside the
+  // field.
+  int distance(Coord from) const {
+    if (!contains(from))
+      return -1;
+    uint16_t d = dist[index_of(from)];
+    return d == UNREACHED ? -1 : d;
+  }
+
+  // The first move of a shortest path from `from`. False if `from` is the
+  // target or can't reach it.
+  bool next_step(Coord from, Coord &to) const {
+    if (!contains(from))
+      return false;
+    uint8_t k = step[index_of(from)];
+    if (k == NO_STEP)
+      return false;
+    to = from + PATH_DIRS[k];
+    return true;
+  }
+
+  // The whole shortest path from `from` to the target into `out`, `from`
+  // first. Empty if there is none.
+  void path_from(Coord from, std::vector<Coord> &out) const {
+    out.clear();
+    if (distance(from) < 0)
+      return;
+    out.push_back(from);
+    Coord next;
+    while (next_step(out.back(), next))
+      out.push_back(next);
+  }
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+using FrameClock = std::chrono::steady_clock;
+
+// Sleep until `deadline` with sub-millisecond accuracy: the OS sleep is only
+// trusted to within SPIN_MARGIN, the rest is spent yielding.
+inline void precise_sleep_until(FrameClock::time_point deadline) {
+  constexpr auto SPIN_MARGIN = std::chrono::microseconds(1500);
+  if (deadline - FrameClock::now() > SPIN_MARGIN) {
+    std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+  }
+  while (FrameClock::now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+// Turns variable real time into a whole number of fixed simulation steps.
+// Leftover time carries over to the next frame. After a stall, at most
+// max_catch_up steps run in one frame and the rest of the backlog is
+// dropped, so a slow frame can't snowball into slower ones.
+class FixedTimestep {
+private:
+  double step;
+  int max_catch_up;
+  double accumulator = 0.0;
+  size_t dropped = 0;
+
+public:
+  FixedTimestep(double step_seconds, int max_steps_per_frame)
+      : step(step_seconds), max_catch_up(max_steps_per_frame) {}
+
+  // Add `elapsed` seconds of real time; returns how many steps to run now.
+  int advance(double elapsed) {
+    accumulator += elapsed;
+    int steps = 0;
+    while (accumulator >= step and steps < max_catch_up) {
+      accumulator -= step;
+      ++steps;
+    }
+    if (accumulator >= step) {
+      dropped += static_cast<size_t>(accumulator / step);
+      accumulator = 0.0;
+    }
+    return steps;
+  }
+
+  double step_seconds() const { return step; }
+
+  // How far into the next step real time is, 0..1.
+  double alpha() const { return accumulator / step; }
+
+  size_t steps_dropped() const { return dropped; }
+};
+
+// Frame durations in milliseconds, summarized as percentiles at the end.
+class FrameStats {
+private:
+  std::vector<float> samples;
+  // Keeps record() allocation-free for the first MAX_SAMPLES frames; past
+  // that the oldest are overwritten.
+  static constexpr size_t MAX_SAMPLES = 1 << 16;
+  size_t next = 0;
+  size_t total = 0;
+
+public:
+  FrameStats() { samples.reserve(MAX_SAMPLES); }
+
+  void record(double ms) {
+    if (samples.size() < MAX_SAMPLES) {
+      samples.push_back(static_cast<float>(ms));
+    } else {
+      samples[next] = static_cast<float>(ms);
+      next = (next + 1) % MAX_SAMPLES;
+    }
+    ++total;
+  }
+
+  size_t count() const { return total; }
+
+  // p in [0, 100], nearest rank. 0 with no samples.
+  double percentile(double p) const {
+    if (samples.empty())
+      return 0.0;
+    std::vector<float> sorted = samples;
+    size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+  }
+
+  double mean() const {
+    double sum = 0.0;
+    for (float s : samples)
+      sum += s;
+    return samples.empty() ? 0.0 : sum / samples.size();
+  }
+
+  void report(std::ostream &out) const {
+    out << "Frame time (ms): p50 " << percentile(50) << ", p95 "
+        << percentile(95) << ", p99 " << percentile(99) << ", max "
+        << percentile(100) << " over " << count() << " frames";
+    if (mean() > 0.0)
+      out << " (" << 1000.0 / mean() << " FPS)";
+    out << "\n";
+  }
+};
@@ -1,15 +1,23 @@
 #pragma once
+#include "AStar.h"
+#include "BlockAccessor.h"
 #include "BlockType.h"
 #include "Coord.h"
 #include "FastRand.h"
+#include "FlowField.h"
 #include "Mob.h"
 #include "MobStorage.h"
 #include "Pathfinding.h"
 #include "Pixel.h"
 #include "Terrain.h"
+#include "ThreadPool.h"
 #include "Window.h"
 #include "World.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <string>
+#include <vector>
 
 class GameWindow : public Window {
 private:
@@ -20,13 +28,59 @@ private:
   int &facing;
   int *inventory;
   int &selected_block;
-  int fall_timer = 0;
-  const int GRAVITY_INTERVAL = 5;
-
-  int spawn_timer = 0;
-  const int SPAWN_INTERVAL = 120;
-  const int MOB_MOVE_INTERVAL = 10;
-  int mob_move_timer = 0;
+  // Simulation timers, in seconds.
+  double fall_timer = 0.0;
+  const double GRAVITY_PERIOD = 0.25;
+
+  const Pixel LOADING_PIXEL = {':', Color::GRAY};
+  // Sized to the screen; only reallocated when the terminal is resized.
+  std::vector<BlockType> region;
+  std::string hud;
+
+  double spawn_timer = 0.0;
+  const double SPAWN_PERIOD = 6.0;
+  const double MOB_MOVE_PERIOD = 0.5;
+  double mob_move_timer = 0.0;
+
+  // Paths to the player for all mobs at once, rebuilt every mob move.
+  FlowField chase_field;
+  const int CHASE_RADIUS_X = 60;
+  const int CHASE_RADIUS_Y = CHUNK_SIZE;
+  const int CHASE_MAX_STEPS = 30;
+
+  // Mobs the field can't lead (too far, or around a long detour) get an A*
+  // search of up to FAR_CHASE_MAX_STEPS; at most FAR_CHASE_SEARCHES a move.
+  const int FAR_CHASE_MAX_STEPS = 90;
+  const size_t FAR_CHASE_SEARCHES = 8;
+  std::vector<Coord> plan;
+
+  // Mob moves are planned on ai_threads workers (0: on this thread), see
+  // move_mobs. One pathfinder per task.
+  unsigned ai_threads = WorkStealingPool::default_thread_count();
+  std::unique_ptr<WorkStealingPool> ai_pool;
+  std::vector<AStarPathfinder> searchers;
+  std::vector<size_t> searches;           // VIEW mobs queued for A*
+  std::vector<std::vector<Coord>> search_paths;
+  std::vector<Coord> intent;              // per mob: where it moves this turn
+
+  // Simulation tiers (see SimTier). VIEW covers the last rendered screen
+  // plus VIEW_MARGIN; MID reaches MID_RADIUS and moves every MID_MOVE_EVERY
+  // mob moves; FAR mobs are split into FAR_SLICES index ranges, one settled
+  // per mob move, so each falls up to FAR_SLICES blocks at once.
+  const int VIEW_MARGIN = 4;
+  const int MID_RADIUS = 96;
+  const int MID_MOVE_EVERY = 2;
+  const int FAR_SLICES = 8;
+  int view_half_w = SCREEN_WIDTH / 2;
+  int view_half_h = SCREEN_HEIGHT / 2;
+  unsigned mob_moves = 0;
+
+  // Smoothed player speed in blocks per second, drives chunk prefetch
+  // lookahead.
+  int last_player_x;
+  double velocity_x = 0.0;
+  const double VELOCITY_SMOOTHING = 0.2; // seconds
+  const double PREFETCH_CHUNKS_PER_SPEED = 0.15;
 
 public:
   bool wants_inventory = false;
@@ -34,7 +88,21 @@ public:
 
   GameWindow(World &w, int &px, int &py, int &f, int *inv, int &sel)
       : world(w), player_x(px), player_y(py), facing(f), inventory(inv),
-        selected_block(sel) {}
+        selected_block(sel), last_player_x(px) {
+    world.add_block_listener(&mobs.paths);
+  }
+
+  ~GameWindow() override { world.remove_block_listener(&mobs.paths); }
+
+  const PathCacheStats &path_stats() const { return mobs.paths.stats(); }
+  MobStorage &get_mobs() { return mobs; }
+
+  // Workers used to plan mob moves; 0 plans on the calling thread. Results
+  // don't depend on it.
+  void set_ai_threads(unsigned threads) {
+    ai_threads = threads;
+    ai_pool.reset();
+  }
 
   bool handle_input(const InputState &input) override {
     if (input.quit) {
@@ -47,6 +115,8 @@ public:
       return false;
     }
 
+    BlockAccessor blocks(world);
+
     int nw_x = player_x;
     if (input.move_left) {
       nw_x--;
@@ -59,42 +129,42 @@ public:
 
     if (input.jump) {
       bool on_ground =
-          world.get_block(player_x, player_y + 1) != BlockType::AIR;
+          blocks.get_block(player_x, player_y + 1) != BlockType::AIR;
       bool above_clear =
-          world.get_block(player_x, player_y - 1) == BlockType::AIR;
+          blocks.get_block(player_x, player_y - 1) == BlockType::AIR;
       if (on_ground && above_clear) {
         player_y--;
-        fall_timer = 0;
+        fall_timer = 0.0;
       }
     }
 
     if (input.mine_left) {
-      BlockType target = world.get_block(player_x - 1, player_y);
+      BlockType target = blocks.get_block(player_x - 1, player_y);
       if (target != BlockType::AIR && target != BlockType::BEDROCK) {
-        world.set_block(player_x - 1, player_y, BlockType::AIR);
+        blocks.set_block(player_x - 1, player_y, BlockType::AIR);
         inventory[static_cast<int>(target)]++;
       }
     }
     if (input.mine_right) {
-      BlockType target = world.get_block(player_x + 1, player_y);
+      BlockType target = blocks.get_block(player_x + 1, player_y);
       if (target != BlockType::AIR && target != BlockType::BEDROCK) {
-        world.set_block(player_x + 1, player_y, BlockType::AIR);
+        blocks.set_block(player_x + 1, player_y, BlockType::AIR);
         inventory[static_cast<int>(target)]++;
       }
     }
     if (input.mine_up) {
-      BlockType target = world.get_block(player_x, player_y - 1);
+      BlockType target = blocks.get_block(player_x, player_y - 1);
       if (target != BlockType::AIR && target != BlockType::BEDROCK) {
-        world.set_block(player_x, player_y - 1, BlockType::AIR);
+        blocks.set_block(player_x, player_y - 1, BlockType::AIR);
         inventory[static_cast<int>(target)]++;
         player_y--;
         // fall_timer = 0;
       }
     }
     if (input.mine_down) {
-      BlockType target = world.get_block(player_x, player_y + 1);
+      BlockType target = blocks.get_block(player_x, player_y + 1);
       if (target != BlockType::AIR && target != BlockType::BEDROCK) {
-        world.set_block(player_x, player_y + 1, BlockType::AIR);
+        blocks.set_block(player_x, player_y + 1, BlockType::AIR);
         inventory[static_cast<int>(target)]++;
       }
     }
@@ -102,7 +172,7 @@ public:
     if (input.place_block) {
       int place_x, place_y;
       bool on_ground =
-          world.get_block(player_x, player_y + 1) != BlockType::AIR;
+          blocks.get_block(player_x, player_y + 1) != BlockType::AIR;
       if (on_ground) {
         place_x = player_x + facing;
         place_y = player_y;
@@ -110,10 +180,10 @@ public:
         place_x = player_x;
         place_y = player_y + 1;
       }
-      if (world.get_block(place_x, place_y) == BlockType::AIR) {
+      if (blocks.get_block(place_x, place_y) == BlockType::AIR) {
         BlockType block_toplace = static_cast<BlockType>(selected_block);
         if (inventory[selected_block] > 0) {
-          world.set_block(place_x, place_y, block_toplace);
+          blocks.set_block(place_x, place_y, block_toplace);
           inventory[selected_block]--;
         }
       }
@@ -123,145 +193,276 @@ public:
       selected_block = input.select_block;
     }
 
-    if (world.get_block(nw_x, player_y) == BlockType::AIR) {
+    if (blocks.get_block(nw_x, player_y) == BlockType::AIR) {
       player_x = nw_x;
     }
 
-    fall_timer++;
-    if (fall_timer >= GRAVITY_INTERVAL) {
-      fall_timer = 0;
-      if (world.get_block(player_x, player_y + 1) == BlockType::AIR) {
-        player_y++;
-      }
-    }
+    return false;
+  }
 
-    ++spawn_timer;
-    if (spawn_timer >= SPAWN_INTERVAL) {
-      spawn_timer = 0;
+  void update(double dt) override {
+    // Scoped: evict_to_budget below must not see a live BlockAccessor.
+    {
+      BlockAccessor blocks(world);
 
-      uint32_t r = fast_rand();
-      int offset = (r & 31) + 15;
-      if (r&32) {
-        offset = -offset;
+      fall_timer += dt;
+      if (fall_timer >= GRAVITY_PERIOD) {
+        fall_timer -= GRAVITY_PERIOD;
+        if (blocks.get_block(player_x, player_y + 1) == BlockType::AIR) {
+          player_y++;
+        }
       }
 
-      int spawn_x = player_x + offset;
-      int spawn_y = player_y;
+      spawn_timer += dt;
+      if (spawn_timer >= SPAWN_PERIOD) {
+        spawn_timer -= SPAWN_PERIOD;
+
+        uint32_t r = fast_rand();
+        int offset = (r & 31) + 15;
+        if (r&32) {
+          offset = -offset;
+        }
 
-      while (spawn_y < CHUNK_SIZE - 1 and
-             world.get_block(spawn_x, spawn_y) == BlockType::AIR) {
-        ++spawn_y;
+        int spawn_x = player_x + offset;
+        int spawn_y = player_y;
+        const int lowest = player_y + CHUNK_SIZE;
+
+        while (spawn_y < lowest and
+               blocks.get_block(spawn_x, spawn_y) == BlockType::AIR) {
+          ++spawn_y;
+        }
+        --spawn_y;
+
+        if (spawn_y < lowest - 1) {
+          mobs.add(spawn_x, spawn_y, 20, MobType::ZOMBIE, AIState::CHASING);
+        }
       }
-      --spawn_y;
 
-      if (spawn_y > 0) {
-        mobs.add(spawn_x, spawn_y, 20, MobType::ZOMBIE, AIState::CHASING);
+      mob_move_timer += dt;
+      if (mob_move_timer >= MOB_MOVE_PERIOD) {
+        mob_move_timer -= MOB_MOVE_PERIOD;
+
+        Coord player_pos = {player_x, player_y};
+        mobs.cull_dead();
+        mobs.assign_tiers(player_pos, view_half_w + VIEW_MARGIN,
+                          view_half_h + VIEW_MARGIN, MID_RADIUS);
+        move_mobs(player_pos);
+        ++mob_moves;
       }
     }
 
-    ++mob_move_timer;
-    if (mob_move_timer >= MOB_MOVE_INTERVAL) {
-      mob_move_timer = 0;
+    double speed = (player_x - last_player_x) / dt;
+    double k = std::min(1.0, dt / VELOCITY_SMOOTHING);
+    velocity_x += k * (speed - velocity_x);
+    last_player_x = player_x;
+    int dir = facing;
+    if (velocity_x > 1.0)
+      dir = 1;
+    else if (velocity_x < -1.0)
+      dir = -1;
+    int lookahead =
+        static_cast<int>(std::abs(velocity_x) * PREFETCH_CHUNKS_PER_SPEED);
+    world.prefetch_around(player_x, player_y, dir, lookahead);
+    world.evict_to_budget(player_x, player_y);
+  }
 
-      Coord player_pos = {player_x, player_y};
+  void render(ScreenBuffer &screen) override {
+    screen.clear();
 
-      for (size_t i = 0; i < mobs.count(); ++i) {
-        Coord mob_pos = mobs.get_pos(i);
+    const int width = screen.get_width();
+    const int height = screen.get_height();
+    view_half_w = width / 2;
+    view_half_h = height / 2;
+    if (region.size() != static_cast<size_t>(width) * height) {
+      region.resize(static_cast<size_t>(width) * height);
+    }
 
-        int dx=mob_pos.x-player_x;
-        int dy=mob_pos.y-player_y;
+    int cam_x = player_x - width / 2;
+    int cam_y = player_y - height / 2;
 
-        if((dx*dx+dy*dy)>3600){
-          continue;
-        }
+    // Buried ores already come back as STONE (per-chunk exposure masks).
+    world.peek_visible_region(cam_x, cam_y, width, height, region.data());
 
-        std::vector<Coord> path = bfs_findpath(mob_pos, player_pos, world, 30);
+    for (int sy = 0; sy < height; ++sy) {
+      const BlockType *row = region.data() + sy * width;
 
-        if (path.size() >= 2) {
-          mobs.set_pos(i, path[1]);
-        } else {
-          if (world.get_block(mob_pos.x, mob_pos.y + 1) == BlockType::AIR) {
-            mobs.set_pos(i, {mob_pos.x, mob_pos.y + 1});
-          }
+      for (int sx = 0; sx < width; ++sx) {
+        BlockType block = row[sx];
+        if (block == UNLOADED_BLOCK) {
+          // Chunk still generating on a worker; don't stall the frame.
+          screen.set_pixel(sx, sy, LOADING_PIXEL);
+          continue;
         }
+        screen.set_pixel(sx, sy, block_to_pixel(block));
       }
     }
 
-    return false;
+    screen.set_pixel(width / 2, height / 2, {'$', Color::BRIGHT_CYAN});
+
+    mobs.grid.query(cam_x, cam_y, cam_x + width - 1, cam_y + height - 1,
+                    [&](size_t i) {
+                      screen.set_pixel(mobs.x[i] - cam_x, mobs.y[i] - cam_y,
+                                       mob_to_pixel(mobs.type[i]));
+                    });
+
+    // Built in place: the numbers fit std::string's small buffer, and `hud`
+    // keeps its capacity between frames.
+    hud.clear();
+    hud += "Pos: (";
+    hud += std::to_string(player_x);
+    hud += ",";
+    hud += std::to_string(player_y);
+    hud += ")  [WASD+W]Move  [Arrows]Mine [1-6]Select [E]Inventory "
+           "[Space]Place  [Q]Quit";
+    screen.draw_text(0, 0, hud, Color::MAGENTA);
+
+    static const char *const INV_NAMES[] = {"Grass", "Dirt", "Stone",
+                                            "Iron",  "Gold", "Dia"};
+    hud.clear();
+    hud += "Inv:";
+    for (int b = 1; b <= 6; ++b) {
+      hud += (selected_block == b ? " >" : "  ");
+      hud += INV_NAMES[b - 1];
+      hud += ":";
+      hud += std::to_string(inventory[b]);
+    }
+    screen.draw_text(0, 1, hud, Color::YELLOW);
   }
 
-  void render(ScreenBuffer &screen) override {
-    screen.clear();
+  bool is_opaque() const override { return true; }
 
-    int cam_x = player_x - SCREEN_WIDTH / 2;
-    int cam_y = player_y - SCREEN_HEIGHT / 2;
-
-    for (int sy = 0; sy < SCREEN_HEIGHT; ++sy) {
-      for (int sx = 0; sx < SCREEN_WIDTH; ++sx) {
-        int wx = cam_x + sx;
-        int wy = cam_y + sy;
-
-        BlockType block;
-        if (wy < 0) {
-          block = BlockType::AIR;
-        } else if (wy >= CHUNK_SIZE) {
-          block = BlockType::BEDROCK;
-        } else {
-          block = world.get_block(wx, wy);
+private:
+  // One mob move in three phases, with the same result for any number of
+  // AI threads:
+  //  1. prepare (main thread): VIEW mobs follow their cached path or the
+  //     shared flow field; the first FAR_CHASE_SEARCHES (in index order)
+  //     the field can't lead are queued for A*.
+  //  2. plan (AI threads): the queued A* searches, MID steering and the FAR
+  //     slice's fall, each mob's move written to `intent`. Only reads
+  //     resident chunks (ResidentBlocks) and the mob columns; the main
+  //     thread waits, so nothing changes under them.
+  //  3. commit (main thread): cache the A* paths, then apply every intent
+  //     in index order.
+  void move_mobs(Coord player_pos) {
+    intent.resize(mobs.count());
+    for (size_t i = 0; i < mobs.count(); ++i)
+      intent[i] = mobs.get_pos(i);
+
+    prepare_view_mobs(player_pos);
+    plan_mob_moves(player_pos);
+    commit_mob_moves(player_pos);
+  }
+
+  void prepare_view_mobs(Coord player_pos) {
+    BlockAccessor blocks(world);
+    bool field_built = false;
+    searches.clear();
+
+    for (size_t i : mobs.mobs_in(SimTier::VIEW)) {
+      Coord mob_pos = mobs.get_pos(i);
+
+      Coord next;
+      bool has_step = mobs.paths.next_step(i, mob_pos, player_pos, next);
+      if (!has_step and mob_pos != player_pos) {
+        // Replan from the shared field, built at most once per move, or
+        // with A* for mobs it can't lead.
+        if (!field_built) {
+          chase_field.build(world, player_pos, CHASE_RADIUS_X, CHASE_RADIUS_Y,
+                            CHASE_MAX_STEPS);
+          field_built = true;
         }
-        bool is_ore = (block == BlockType::DIAMOND or
-                       block == BlockType::GOLD or block == BlockType::IRON);
-
-        if (is_ore) {
-          bool exposed = world.get_block(wx, wy + 1) == BlockType::AIR or
-                         world.get_block(wx + 1, wy) == BlockType::AIR or
-                         world.get_block(wx - 1, wy) == BlockType::AIR or
-                         world.get_block(wx, wy - 1) == BlockType::AIR;
-
-          if (exposed) {
-            screen.set_pixel(sx, sy, block_to_pixel(block));
-          } else {
-            screen.set_pixel(sx, sy, block_to_pixel(BlockType::STONE));
-          }
-        } else {
-          screen.set_pixel(sx, sy, block_to_pixel(block));
+        chase_field.path_from(mob_pos, plan);
+        if (plan.empty() and searches.size() < FAR_CHASE_SEARCHES) {
+          searches.push_back(i);
+          continue;
         }
+        has_step = mobs.paths.store(i, plan, player_pos, next);
       }
+
+      if (has_step) {
+        intent[i] = next;
+      } else if (blocks.get_block(mob_pos.x, mob_pos.y + 1) ==
+                 BlockType::AIR) {
+        intent[i] = {mob_pos.x, mob_pos.y + 1};
+      }
+    }
+  }
+
+  void plan_mob_moves(Coord player_pos) {
+    if (ai_threads > 0 and !ai_pool)
+      ai_pool = std::make_unique<WorkStealingPool>(ai_threads);
+
+    const std::vector<size_t> &mid = mobs.mobs_in(SimTier::MID);
+    bool mid_due = mob_moves % MID_MOVE_EVERY == 0;
+    size_t per_slice = (mobs.count() + FAR_SLICES - 1) / FAR_SLICES;
+    size_t far_begin = (mob_moves % FAR_SLICES) * per_slice;
+    size_t far_end = std::min(far_begin + per_slice, mobs.count());
+    far_begin = std::min(far_begin, far_end);
+
+    size_t tasks = std::max<size_t>(1, ai_threads);
+    while (searchers.size() < tasks) {
+      searchers.emplace_back(FAR_CHASE_MAX_STEPS);
+      searchers.back().set_jump_points(true);
     }
+    search_paths.resize(searches.size());
+
+    const MobStorage &snapshot = mobs;
+    run_tasks(ai_pool.get(), tasks, [&](size_t t) {
+      ResidentBlocks blocks(world);
+
+      auto [s0, s1] = task_range(t, tasks, searches.size());
+      for (size_t k = s0; k < s1; ++k) {
+        size_t i = searches[k];
+        Coord from = {snapshot.x[i], snapshot.y[i]};
+        search_paths[k] = searchers[t].find_path_in(from, player_pos, blocks,
+                                                    FAR_CHASE_MAX_STEPS);
+      }
 
-    screen.set_pixel(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2,
-                     {'$', Color::BRIGHT_CYAN});
+      if (mid_due) {
+        auto [m0, m1] = task_range(t, tasks, mid.size());
+        for (size_t k = m0; k < m1; ++k)
+          intent[mid[k]] = steer(blocks, mid[k], player_pos);
+      }
 
-    for (size_t i = 0; i < mobs.count(); ++i) {
-      int sx = mobs.x[i] - cam_x;
-      int sy = mobs.y[i] - cam_y;
-      if (sx >= 0 && sx < SCREEN_WIDTH && sy >= 0 && sy < SCREEN_HEIGHT) {
-        screen.set_pixel(sx, sy, mob_to_pixel(mobs.type[i]));
+      auto [f0, f1] = task_range(t, tasks, far_end - far_begin);
+      snapshot.plan_gravity(world, far_begin + f0, far_begin + f1,
+                            FAR_SLICES, SimTier::FAR, intent.data());
+    });
+  }
+
+  void commit_mob_moves(Coord player_pos) {
+    BlockAccessor blocks(world);
+    for (size_t k = 0; k < searches.size(); ++k) {
+      size_t i = searches[k];
+      Coord mob_pos = mobs.get_pos(i);
+      Coord next;
+      if (mobs.paths.store(i, search_paths[k], player_pos, next)) {
+        intent[i] = next;
+      } else if (blocks.get_block(mob_pos.x, mob_pos.y + 1) ==
+                 BlockType::AIR) {
+        intent[i] = {mob_pos.x, mob_pos.y + 1};
       }
     }
 
-    std::string hud = "Pos: (" + std::to_string(player_x) + "," +
-                      std::to_string(player_y) +
-                      ")  [WASD+W]Move  [Arrows]Mine [1-6]Select [E]Inventory "
-                      "[Space]Place  [Q]Quit";
-
-    std::string inv_hud = "Inv:";
-    inv_hud += (selected_block == 1 ? " >" : "  ");
-    inv_hud += "Grass:" + std::to_string(inventory[1]);
-    inv_hud += (selected_block == 2 ? " >" : "  ");
-    inv_hud += "Dirt:" + std::to_string(inventory[2]);
-    inv_hud += (selected_block == 3 ? " >" : "  ");
-    inv_hud += "Stone:" + std::to_string(inventory[3]);
-    inv_hud += (selected_block == 4 ? " >" : "  ");
-    inv_hud += "Iron:" + std::to_string(inventory[4]);
-    inv_hud += (selected_block == 5 ? " >" : "  ");
-    inv_hud += "Gold:" + std::to_string(inventory[5]);
-    inv_hud += (selected_block == 6 ? " >" : "  ");
-    inv_hud += "Dia:" + std::to_string(inventory[6]);
-
-    screen.draw_text(0, 0, hud, Color::MAGENTA);
-    screen.draw_text(0, 1, inv_hud, Color::YELLOW);
+    for (size_t i = 0; i < mobs.count(); ++i) {
+      if (intent[i] != mobs.get_pos(i))
+        mobs.set_pos(i, intent[i]);
+    }
   }
 
-  bool is_opaque() const override { return true; }
+  // Greedy steering for a MID mob: fall if unsupported, else walk or climb
+  // towards the player.
+  Coord steer(ResidentBlocks &blocks, size_t i, Coord player_pos) const {
+    Coord pos = {mobs.x[i], mobs.y[i]};
+    if (blocks.get_block(pos.x, pos.y + 1) == BlockType::AIR)
+      return {pos.x, pos.y + 1};
+    if (player_pos.x == pos.x)
+      return pos;
+    int dx = player_pos.x > pos.x ? 1 : -1;
+    if (can_step(blocks, pos, {dx, 0}))
+      return {pos.x + dx, pos.y};
+    if (can_step(blocks, pos, {dx, -1}))
+      return {pos.x + dx, pos.y - 1};
+    return pos;
+  }
 };
@@ -1,5 +1,20 @@
 #pragma once
+#include <cstddef>
+
+#ifdef _WIN32
 #include <conio.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
 
 struct InputState {
   bool move_left = false;
@@ -16,6 +31,135 @@ struct InputState {
   bool confirm_inventory = false;
 };
 
+// A plain (non-arrow) key press, shared by both backends.
+inline void apply_key(InputState &state, int key) {
+  switch (key) {
+  case 13:
+  case 10:
+    state.confirm_inventory = true;
+    break;
+  case 'a':
+  case 'A':
+    state.move_left = true;
+    break;
+  case 'd':
+  case 'D':
+    state.move_right = true;
+    break;
+  case 'w':
+  case 'W':
+    state.jump = true;
+    break;
+  case ' ':
+    state.place_block = true;
+    break;
+  case 'q':
+  case 'Q':
+    state.quit = true;
+    break;
+  case 'e':
+  case 'E':
+    state.open_inventory = true;
+    break;
+  case '1':
+    state.select_block = 1;
+    break;
+  case '2':
+    state.select_block = 2;
+    break;
+  case '3':
+    state.select_block = 3;
+    break;
+  case '4':
+    state.select_block = 4;
+    break;
+  case '5':
+    state.select_block = 5;
+    break;
+  case '6':
+    state.select_block = 6;
+    break;
+  }
+}
+
+// The final byte of an ANSI arrow key sequence.
+inline void apply_arrow(InputState &state, unsigned char final_byte) {
+  switch (final_byte) {
+  case 'D':
+    state.mine_left = true;
+    break;
+  case 'C':
+    state.mine_right = true;
+    break;
+  case 'A':
+    state.mine_up = true;
+    break;
+  case 'B':
+    state.mine_down = true;
+    break;
+  }
+}
+
+// Decodes terminal input bytes: ESC [ A..D (or ESC O A..D) are the arrow
+// keys, also with a modifier (ESC [ 1 ; 5 D is Ctrl+Left); other ESC [
+// sequences (Home, PgUp, F5, ...) are skipped whole, and everything else
+// goes through apply_key. Returns how many bytes were consumed; an escape
+// sequence cut off at the end is left unconsumed so the caller can retry it
+// with the next read.
+inline size_t parse_input(const unsigned char *bytes, size_t n,
+                          InputState &state) {
+  size_t i = 0;
+  while (i < n) {
+    if (bytes[i] != 27) {
+      apply_key(state, bytes[i]);
+      ++i;
+      continue;
+    }
+    if (i + 1 == n)
+      return i;
+    if (bytes[i + 1] != '[' and bytes[i + 1] != 'O') {
+      ++i; // a lone ESC, ignored
+      continue;
+    }
+    if (i + 2 == n)
+      return i;
+    if (bytes[i + 1] == 'O') {
+      apply_arrow(state, bytes[i + 2]);
+      i += 3;
+      continue;
+    }
+
+    // ESC [, parameter bytes 0x30-0x3F, intermediate bytes 0x20-0x2F, then
+    // a final byte 0x40-0x7E.
+    size_t end = i + 2;
+    while (end < n and bytes[end] >= 0x30 and bytes[end] <= 0x3F)
+      ++end;
+    size_t params_end = end;
+    while (end < n and bytes[end] >= 0x20 and bytes[end] <= 0x2F)
+      ++end;
+    if (end == n)
+      return i;
+    if (bytes[end] < 0x40 or bytes[end] > 0x7E) {
+      i = end; // malformed: drop what came before the stray byte
+      continue;
+    }
+    // Only no parameters or "1;<modifier>", and no intermediates.
+    bool arrow = end == params_end;
+    if (arrow and params_end > i + 2) {
+      arrow = params_end - (i + 2) >= 3 and bytes[i + 2] == '1' and
+              bytes[i + 3] == ';';
+      for (size_t k = i + 4; arrow and k < params_end; ++k)
+        arrow = bytes[k] >= '0' and bytes[k] <= '9';
+    }
+    if (arrow)
+      apply_arrow(state, bytes[end]);
+    i = end + 1;
+  }
+  return i;
+}
+
+#ifdef _WIN32
+
 inline InputState get_input() {
   InputState state;
 
@@ -41,54 +185,138 @@ inline InputState get_input() {
         break;
       }
     } else {
-      switch (key) {
-      case 13:
-        state.confirm_inventory = true;
-        break;
-      case 'a':
-      case 'A':
-        state.move_left = true;
-        break;
-      case 'd':
-      case 'D':
-        state.move_right = true;
-        break;
-      case 'w':
-      case 'W':
-        state.jump = true;
-        break;
-      case ' ':
-        state.place_block = true;
-        break;
-      case 'q':
-      case 'Q':
-        state.quit = true;
-        break;
-      case 'e':
-      case 'E':
-        state.open_inventory = true;
-        break;
-      case '1':
-        state.select_block = 1;
-        break;
-      case '2':
-        state.select_block = 2;
-        break;
-      case '3':
-        state.select_block = 3;
-        break;
-      case '4':
-        state.select_block = 4;
-        break;
-      case '5':
-        state.select_block = 5;
-        break;
-      case '6':
-        state.select_block = 6;
-        break;
-      }
+      apply_key(state, key);
+    }
+  }
+
+  return state;
+}
+
+// Sleep until a key is pressed or timeout_ms passes. True if there is input.
+inline bool wait_for_input(int timeout_ms) {
+  if (_kbhit())
+    return true;
+  WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE),
+                      static_cast<DWORD>(timeout_ms));
+  return _kbhit() != 0;
+}
+
+#else
+
+// Puts stdin in raw mode the first time input is read: no line buffering,
+// no echo, and reads that return immediately. A terminal gets that from
+// VMIN = VTIME = 0 rather than O_NONBLOCK, which would also apply to stdout
+// (same open file) and make std::cout fail with EAGAIN. Output processing
+// and Ctrl-C are left on.
+//
+// The original settings come back at exit and on SIGINT/SIGTERM/SIGHUP.
+class RawTerminal {
+public:
+  static void enable() {
+    if (state().enabled)
+      return;
+    state().enabled = true;
+
+    if (!isatty(STDIN_FILENO)) {
+      // A pipe or file: only the fd needs to stop blocking.
+      state().pipe = true;
+      int flags = fcntl(STDIN_FILENO, F_GETFL);
+      if (flags != -1)
+        fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+      return;
     }
+    if (tcgetattr(STDIN_FILENO, &state().saved) != 0)
+      return;
+
+    termios raw = state().saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_iflag &= ~(ICRNL | IXON);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+      return;
+    state().raw = true;
+
+    std::atexit(restore);
+    for (int sig : {SIGINT, SIGTERM, SIGHUP})
+      std::signal(sig, on_signal);
+  }
+
+  // A pipe or file has run dry once a read returns 0; a raw terminal
+  // returns 0 whenever nothing was typed.
+  static void note_read(ssize_t got) {
+    if (got == 0 and state().pipe)
+      state().ended = true;
   }
+  static bool input_ended() { return state().ended; }
+
+  // Safe to call more than once, and from a signal handler.
+  static void restore() {
+    if (state().raw) {
+      tcsetattr(STDIN_FILENO, TCSAFLUSH, &state().saved);
+      state().raw = false;
+    }
+  }
+
+private:
+  struct State {
+    bool enabled = false;
+    bool raw = false;
+    bool pipe = false;
+    bool ended = false;
+    termios saved{};
+  };
+
+  static State &state() {
+    static State s;
+    return s;
+  }
+
+  static void on_signal(int sig) {
+    restore();
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+  }
+};
+
+// Everything typed since the last call, drained with a single read().
+inline InputState get_input() {
+  // Tail of an escape sequence split across two reads.
+  static unsigned char pending[16];
+  static size_t pending_len = 0;
+
+  RawTerminal::enable();
+  InputState state;
+
+  unsigned char bytes[256];
+  for (size_t i = 0; i < pending_len; ++i)
+    bytes[i] = pending[i];
+  ssize_t got = read(STDIN_FILENO, bytes + pending_len,
+                     sizeof(bytes) - pending_len);
+  RawTerminal::note_read(got);
+  size_t n = pending_len + (got > 0 ? static_cast<size_t>(got) : 0);
+
+  size_t used = parse_input(bytes, n, state);
+  pending_len = n - used;
+  if (pending_len > sizeof(pending))
+    pending_len = 0; // no key sequence is this long: drop it
+  for (size_t i = 0; i < pending_len; ++i)
+    pending[i] = bytes[used + i];
 
   return state;
-}
\ No newline at end of file
+}
+
+// Sleep until stdin is readable or timeout_ms passes. True if there is
+// input. A negative timeout waits indefinitely. Once a piped stdin is at
+// its end (it would always poll readable) this just sleeps.
+inline bool wait_for_input(int timeout_ms) {
+  RawTerminal::enable();
+  if (RawTerminal::input_ended()) {
+    poll(nullptr, 0, timeout_ms);
+    return false;
+  }
+  pollfd fd{STDIN_FILENO, POLLIN, 0};
+  return poll(&fd, 1, timeout_ms) > 0 and (fd.revents & POLLIN);
+}
+
+#endif
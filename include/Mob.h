@@ -12,6 +12,14 @@ enum class AIState : uint8_t{
     IDLE
 };
 
+// Simulation level of detail, by distance from the player.
+enum class SimTier : uint8_t{
+    VIEW=0, // on screen: full pathfinding every mob move
+    MID,    // nearby: greedy steering at a reduced rate
+    FAR,    // everything else: occasional batched fall
+    COUNT
+};
+
 struct Mob{
     int x,y;
     int hp;
@@ -0,0 +1,387 @@
+#pragma once
+#include "BlockAccessor.h"
+#include "BlockType.h"
+#include "Coord.h"
+#include "FastRand.h"
+#include "FlowField.h"
+#include "Mob.h"
+#include "MobStorage.h"
+#include "World.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Mob-update benchmark suite: game-like scenarios run against each mob
+// layout, timed over repeated trials after a warmup, and written out as CSV
+// and JSON for tracking regressions. Run with `game --bench [prefix]`.
+//
+// Every layout offers the same small interface (add, remove, count, pos,
+// set_pos, for_each_in_view) so a scenario is written once as a template.
+
+// An array of full mob structs, as a typical engine would have them; about
+// 80 bytes each, so one or two mobs per cache line.
+struct BenchAosMobs {
+  static constexpr const char *NAME = "aos";
+
+  struct Mob {
+    int x, y;
+    int vx, vy;
+    int hp, max_hp;
+    int damage;
+    int ai_state;
+    int target_x, target_y;
+    int anim_frame;
+    int spawn_time;
+    int last_attack;
+    int path_length;
+    int flags;
+    int loot_table;
+    int armor;
+    int aggro_range;
+    int padding[2];
+  };
+  std::vector<Mob> mobs;
+
+  void add(int x, int y, int hp) {
+    Mob m{};
+    m.x = x;
+    m.y = y;
+    m.hp = hp;
+    m.max_hp = hp;
+    mobs.push_back(m);
+  }
+  void remove(size_t i) {
+    mobs[i] = mobs.back();
+    mobs.pop_back();
+  }
+  size_t count() const { return mobs.size(); }
+  Coord pos(size_t i) const { return {mobs[i].x, mobs[i].y}; }
+  void set_pos(size_t i, Coord p) {
+    mobs[i].x = p.x;
+    mobs[i].y = p.y;
+  }
+  template <typename F> void for_each_in_view(int x0, int y0, int x1, int y1,
+                                              F &&f) const {
+    for (size_t i = 0; i < mobs.size(); ++i) {
+      if (mobs[i].x >= x0 and mobs[i].x <= x1 and mobs[i].y >= y0 and
+          mobs[i].y <= y1)
+        f(i);
+    }
+  }
+};
+
+// MobStorage as it was before the aligned columns: one std::vector<int> per
+// field and no spatial index.
+struct BenchVectorMobs {
+  static constexpr const char *NAME = "vector_columns";
+
+  std::vector<int> x, y, hp, type, state;
+
+  void add(int mx, int my, int mhp) {
+    x.push_back(mx);
+    y.push_back(my);
+    hp.push_back(mhp);
+    type.push_back(0);
+    state.push_back(0);
+  }
+  void remove(size_t i) {
+    x[i] = x.back();
+    y[i] = y.back();
+    hp[i] = hp.back();
+    type[i] = type.back();
+    state[i] = state.back();
+    x.pop_back();
+    y.pop_back();
+    hp.pop_back();
+    type.pop_back();
+    state.pop_back();
+  }
+  size_t count() const { return x.size(); }
+  Coord pos(size_t i) const { return {x[i], y[i]}; }
+  void set_pos(size_t i, Coord p) {
+    x[i] = p.x;
+    y[i] = p.y;
+  }
+  template <typename F> void for_each_in_view(int x0, int y0, int x1, int y1,
+                                              F &&f) const {
+    for (size_t i = 0; i < x.size(); ++i) {
+      if (x[i] >= x0 and x[i] <= x1 and y[i] >= y0 and y[i] <= y1)
+        f(i);
+    }
+  }
+};
+
+// The game's MobStorage, with its path cache and grid kept up to date.
+struct BenchStorageMobs {
+  static constexpr const char *NAME = "mob_storage";
+
+  MobStorage mobs;
+
+  void add(int x, int y, int hp) {
+    mobs.add(x, y, hp, MobType::ZOMBIE, AIState::CHASING);
+  }
+  void remove(size_t i) { mobs.remove(i); }
+  size_t count() const { return mobs.count(); }
+  Coord pos(size_t i) const { return {mobs.x[i], mobs.y[i]}; }
+  void set_pos(size_t i, Coord p) { mobs.set_pos(i, p); }
+  template <typename F> void for_each_in_view(int x0, int y0, int x1, int y1,
+                                              F &&f) const {
+    mobs.grid.query(x0, y0, x1, y1, f);
+  }
+};
+
+struct BenchResult {
+  std::string scenario;
+  std::string layout;
+  size_t mobs;
+  size_t trials;
+  double median_us;
+  double p95_us;
+  double min_us;
+  double max_us;
+};
+
+// Time `trial` `trials` times after `warmup` untimed runs. `setup` runs
+// before every run, outside the timing.
+template <typename Setup, typename Trial>
+BenchResult time_trials(const std::string &scenario, const char *layout,
+                        size_t mobs, int warmup, int trials, Setup &&setup,
+                        Trial &&trial) {
+  std::vector<double> samples;
+  for (int t = 0; t < warmup + trials; ++t) {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    trial();
+    auto end = std::chrono::steady_clock::now();
+    if (t >= warmup) {
+      samples.push_back(
+          std::chrono::duration<double, std::micro>(end - start).count());
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+  auto rank = [&](double p) {
+    return samples[static_cast<size_t>(p / 100.0 * (samples.size() - 1) +
+                                       0.5)];
+  };
+  return {scenario, layout,   mobs,           samples.size(),
+          rank(50), rank(95), samples.front(), samples.back()};
+}
+
+// The world the scenarios run in: chunks across [x0, x0 + width) are made
+// resident up front, and `surface[x - x0]` is the first solid row from the
+// top of each column.
+struct BenchTerrain {
+  World world;
+  int x0;
+  int width;
+  std::vector<int> surface;
+
+  BenchTerrain(int x_begin, int w) : x0(x_begin), width(w) {
+    for (int x = x0; x < x0 + width; ++x) {
+      int y = 0;
+      while (y < CHUNK_SIZE - 1 and world.get_block(x, y) == BlockType::AIR)
+        ++y;
+      surface.push_back(y);
+    }
+  }
+
+  int surface_at(int x) const { return surface[x - x0]; }
+
+  int random_x() const {
+    return x0 + static_cast<int>(fast_rand() % static_cast<uint32_t>(width));
+  }
+};
+
+// Gravity: mobs dropped at random heights fall one block per tick for
+// GRAVITY_TICKS ticks, reading the real world.
+template <typename Layout>
+BenchResult bench_gravity(BenchTerrain &terrain, size_t n, int trials) {
+  const int GRAVITY_TICKS = 8;
+  std::unique_ptr<Layout> layout;
+  auto setup = [&] {
+    layout = std::make_unique<Layout>();
+    seed_fast_rand(1);
+    for (size_t i = 0; i < n; ++i) {
+      int x = terrain.random_x();
+      int top = std::max(1, terrain.surface_at(x));
+      layout->add(x, static_cast<int>(fast_rand() % top), 20);
+    }
+  };
+  auto trial = [&] {
+    BlockAccessor blocks(terrain.world);
+    for (int tick = 0; tick < GRAVITY_TICKS; ++tick) {
+      for (size_t i = 0; i < layout->count(); ++i) {
+        Coord p = layout->pos(i);
+        if (blocks.get_block(p.x, p.y + 1) == BlockType::AIR)
+          layout->set_pos(i, {p.x, p.y + 1});
+      }
+    }
+  };
+  return time_trials("gravity", Layout::NAME, n, 2, trials, setup, trial);
+}
+
+// Chase: the target walks along the surface; every tick the shared flow
+// field is rebuilt around it and each mob in range takes its next step.
+template <typename Layout>
+BenchResult bench_chase(BenchTerrain &terrain, size_t n, int trials) {
+  const int CHASE_TICKS = 10;
+  const int SPREAD = 60;
+  const int start_x = terrain.x0 + terrain.width / 2;
+  std::unique_ptr<Layout> layout;
+  FlowField field;
+  auto setup = [&] {
+    layout = std::make_unique<Layout>();
+    seed_fast_rand(2);
+    for (size_t i = 0; i < n; ++i) {
+      int x = start_x - SPREAD +
+              static_cast<int>(fast_rand() % (2 * SPREAD + 1));
+      layout->add(x, terrain.surface_at(x) - 1, 20);
+    }
+  };
+  auto trial = [&] {
+    for (int tick = 0; tick < CHASE_TICKS; ++tick) {
+      int tx = start_x + tick;
+      Coord target = {tx, terrain.surface_at(tx) - 1};
+      field.build(terrain.world, target, SPREAD + CHASE_TICKS, CHUNK_SIZE,
+                  30);
+      for (size_t i = 0; i < layout->count(); ++i) {
+        Coord next;
+        if (field.next_step(layout->pos(i), next))
+          layout->set_pos(i, next);
+      }
+    }
+  };
+  return time_trials("chase", Layout::NAME, n, 2, trials, setup, trial);
+}
+
+// Churn: every tick 1% of the mobs despawn and as many spawn elsewhere.
+template <typename Layout>
+BenchResult bench_churn(BenchTerrain &terrain, size_t n, int trials) {
+  const int CHURN_TICKS = 20;
+  const size_t per_tick = std::max<size_t>(1, n / 100);
+  std::unique_ptr<Layout> layout;
+  auto setup = [&] {
+    layout = std::make_unique<Layout>();
+    seed_fast_rand(3);
+    for (size_t i = 0; i < n; ++i) {
+      int x = terrain.random_x();
+      layout->add(x, terrain.surface_at(x) - 1, 20);
+    }
+  };
+  auto trial = [&] {
+    for (int tick = 0; tick < CHURN_TICKS; ++tick) {
+      for (size_t k = 0; k < per_tick; ++k)
+        layout->remove(fast_rand() % layout->count());
+      for (size_t k = 0; k < per_tick; ++k) {
+        int x = terrain.random_x();
+        layout->add(x, terrain.surface_at(x) - 1, 20);
+      }
+    }
+  };
+  return time_trials("churn", Layout::NAME, n, 2, trials, setup, trial);
+}
+
+// Render cull: a screen-sized camera pans across the world for CULL_FRAMES
+// frames, collecting the mobs it has to draw.
+template <typename Layout>
+BenchResult bench_render_cull(BenchTerrain &terrain, size_t n, int trials) {
+  const int CULL_FRAMES = 60;
+  auto layout = std::make_unique<Layout>();
+  seed_fast_rand(4);
+  for (size_t i = 0; i < n; ++i) {
+    int x = terrain.random_x();
+    layout->add(x, terrain.surface_at(x) - 1, 20);
+  }
+  size_t drawn = 0;
+  auto trial = [&] {
+    for (int frame = 0; frame < CULL_FRAMES; ++frame) {
+      int cam_x = terrain.x0 + frame * (terrain.width - 80) / CULL_FRAMES;
+      int cam_y = terrain.surface_at(cam_x + 40) - 12;
+      layout->for_each_in_view(cam_x, cam_y, cam_x + 79, cam_y + 23,
+                              [&](size_t) { ++drawn; });
+    }
+  };
+  BenchResult r = time_trials("render_cull", Layout::NAME, n, 2, trials,
+                              [] {}, trial);
+  volatile size_t sink = drawn;
+  (void)sink;
+  return r;
+}
+
+template <typename Layout>
+void bench_layout(BenchTerrain &terrain, size_t n, int trials,
+                  std::vector<BenchResult> &out) {
+  out.push_back(bench_gravity<Layout>(terrain, n, trials));
+  out.push_back(bench_chase<Layout>(terrain, n, trials));
+  out.push_back(bench_churn<Layout>(terrain, n, trials));
+  out.push_back(bench_render_cull<Layout>(terrain, n, trials));
+}
+
+inline void write_bench_csv(const std::vector<BenchResult> &results,
+                            std::ostream &out) {
+  out << "scenario,layout,mobs,trials,median_us,p95_us,min_us,max_us\n";
+  for (const BenchResult &r : results) {
+    out << r.scenario << ',' << r.layout << ',' << r.mobs << ',' << r.trials
+        << ',' << r.median_us << ',' << r.p95_us << ',' << r.min_us << ','
+        << r.max_us << '\n';
+  }
+}
+
+inline void write_bench_json(const std::vector<BenchResult> &results,
+                             std::ostream &out) {
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    out << "  {\"scenario\": \"" << r.scenario << "\", \"layout\": \""
+        << r.layout << "\", \"mobs\": " << r.mobs
+        << ", \"trials\": " << r.trials << ", \"median_us\": " << r.median_us
+        << ", \"p95_us\": " << r.p95_us << ", \"min_us\": " << r.min_us
+        << ", \"max_us\": " << r.max_us << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "]\n";
+}
+
+// Runs every scenario for every layout and population, prints a table and
+// writes <prefix>.csv and <prefix>.json.
+inline void run_mob_benchmark_suite(const std::string &prefix) {
+  const size_t MOB_COUNTS[] = {1000, 10000, 100000};
+  const int TRIALS = 15;
+
+  std::cout << "\n========================================\n";
+  std::cout << "   MOB UPDATE BENCHMARK SUITE\n";
+  std::cout << "   " << TRIALS << " trials per case after 2 warmups\n";
+  std::cout << "========================================\n\n";
+
+  BenchTerrain terrain(-1024, 2048);
+  std::vector<BenchResult> results;
+  for (size_t n : MOB_COUNTS) {
+    bench_layout<BenchAosMobs>(terrain, n, TRIALS, results);
+    bench_layout<BenchVectorMobs>(terrain, n, TRIALS, results);
+    bench_layout<BenchStorageMobs>(terrain, n, TRIALS, results);
+  }
+
+  std::cout << "scenario      layout           mobs     median_us   p95_us\n";
+  for (const BenchResult &r : results) {
+    std::string scenario = r.scenario;
+    std::string layout = r.layout;
+    std::string mobs = std::to_string(r.mobs);
+    scenario.resize(14, ' ');
+    layout.resize(17, ' ');
+    mobs.resize(9, ' ');
+    std::cout << scenario << layout << mobs << r.median_us << "   "
+              << r.p95_us << "\n";
+  }
+
+  std::ofstream csv(prefix + ".csv");
+  write_bench_csv(results, csv);
+  std::ofstream json(prefix + ".json");
+  write_bench_json(results, json);
+  std::cout << "\nWrote " << prefix << ".csv and " << prefix << ".json\n";
+  std::cout << "\n========================================\n\n";
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "ChunkTable.h"
+#include "Coord.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over mob positions, CELL_SIZE blocks square. Each occupied
+// cell has a bucket holding the index and position of every mob in it, so a
+// range query reads a few small contiguous arrays and never touches the mob
+// columns. Cells are found through a FlatKeyTable keyed like chunks.
+//
+// Kept in step by MobStorage: a move within a cell only rewrites the entry,
+// a move across cells is a swap-remove from one bucket and a push onto the
+// next.
+class MobGrid {
+public:
+  static constexpr int CELL_SHIFT = 4;
+  static constexpr int CELL_SIZE = 1 << CELL_SHIFT;
+
+  void insert(size_t mob, Coord pos) {
+    if (mob >= bucket_of.size()) {
+      bucket_of.resize(mob + 1);
+      slot_of.resize(mob + 1);
+    }
+    push(mob, pos, bucket_for(pos));
+  }
+
+  void move(size_t mob, Coord to) {
+    uint32_t b = bucket_for(to);
+    if (b == bucket_of[mob]) {
+      Entry &e = buckets[b][slot_of[mob]];
+      e.x = to.x;
+      e.y = to.y;
+      return;
+    }
+    unlink(mob);
+    push(mob, to, b);
+  }
+
+  // Mirrors MobStorage::remove: `mob` goes away and the last mob takes its
+  // index.
+  void remove(size_t mob) {
+    unlink(mob);
+    size_t last = bucket_of.size() - 1;
+    if (mob != last) {
+      buckets[bucket_of[last]][slot_of[last]].index =
+          static_cast<uint32_t>(mob);
+      bucket_of[mob] = bucket_of[last];
+      slot_of[mob] = slot_of[last];
+    }
+    bucket_of.pop_back();
+    slot_of.pop_back();
+  }
+
+  void clear() {
+    for (std::vector<Entry> &bucket : buckets)
+      bucket.clear();
+    bucket_of.clear();
+    slot_of.clear();
+  }
+
+  // f(index) for every mob with x0 <= x <= x1 and y0 <= y <= y1.
+  template <typename F>
+  void query(int x0, int y0, int x1, int y1, F &&f) const {
+    for (int cy = y0 >> CELL_SHIFT; cy <= y1 >> CELL_SHIFT; ++cy) {
+      for (int cx = x0 >> CELL_SHIFT; cx <= x1 >> CELL_SHIFT; ++cx) {
+        uint32_t b = cells.find(pack_coord({cx, cy}));
+        if (b == NO_BUCKET)
+          continue;
+        for (const Entry &e : buckets[b]) {
+          if (e.x >= x0 and e.x <= x1 and e.y >= y0 and e.y <= y1)
+            f(static_cast<size_t>(e.index));
+        }
+      }
+    }
+  }
+
+  // f(index) for every mob within `radius` of `center` (Euclidean).
+  template <typename F>
+  void query_radius(Coord center, int radius, F &&f) const {
+    int r2 = radius * radius;
+    for (int cy = (center.y - radius) >> CELL_SHIFT;
+         cy <= (center.y + radius) >> CELL_SHIFT; ++cy) {
+      for (int cx = (center.x - radius) >> CELL_SHIFT;
+           cx <= (center.x + radius) >> CELL_SHIFT; ++cx) {
+        uint32_t b = cells.find(pack_coord({cx, cy}));
+        if (b == NO_BUCKET)
+          continue;
+        for (const Entry &e : buckets[b]) {
+          int dx = e.x - center.x;
+          int dy = e.y - center.y;
+          if (dx * dx + dy * dy <= r2)
+            f(static_cast<size_t>(e.index));
+        }
+      }
+    }
+  }
+
+  size_t size() const { return bucket_of.size(); }
+
+private:
+  static constexpr uint32_t NO_BUCKET = 0xFFFFFFFFu;
+
+  struct Entry {
+    uint32_t index;
+    int x, y;
+  };
+
+  // Buckets are never freed: a cell that held mobs once keeps its (possibly
+  // empty) bucket and the capacity that came with it.
+  FlatKeyTable<uint32_t, NO_BUCKET> cells;
+  std::vector<std::vector<Entry>> buckets;
+  std::vector<uint32_t> bucket_of; // per mob
+  std::vector<uint32_t> slot_of;   // per mob, position in its bucket
+
+  uint32_t bucket_for(Coord pos) {
+    uint64_t key = pack_coord({pos.x >> CELL_SHIFT, pos.y >> CELL_SHIFT});
+    uint32_t b = cells.find(key);
+    if (b == NO_BUCKET) {
+      b = static_cast<uint32_t>(buckets.size());
+      buckets.emplace_back();
+      cells.insert(key, b);
+    }
+    return b;
+  }
+
+  void push(size_t mob, Coord pos, uint32_t b) {
+    bucket_of[mob] = b;
+    slot_of[mob] = static_cast<uint32_t>(buckets[b].size());
+    buckets[b].push_back({static_cast<uint32_t>(mob), pos.x, pos.y});
+  }
+
+  void unlink(size_t mob) {
+    std::vector<Entry> &bucket = buckets[bucket_of[mob]];
+    uint32_t slot = slot_of[mob];
+    bucket[slot] = bucket.back();
+    slot_of[bucket[slot].index] = slot;
+    bucket.pop_back();
+  }
+};
@@ -1,56 +1,355 @@
 #pragma once
+#include "BlockAccessor.h"
+#include "BlockType.h"
 #include "Coord.h"
 #include "Mob.h"
+#include "MobGrid.h"
+#include "PathCache.h"
+#include "World.h"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+// The column kernels below take restrict pointers and run in blocks of
+// KERNEL_LANES with per-lane counters: the shape GCC vectorizes at -O2.
+constexpr size_t KERNEL_LANES = 16;
+
+// Take `amount` hp (clamped at 0) from every entry within `radius` of
+// `center`; returns how many. The distance test is in float: it has packed
+// multiplies on baseline x86-64 (32-bit integer ones need SSE4.1) and can't
+// overflow for far-away mobs; it is exact for any radius under 4096.
+inline size_t damage_columns(const int32_t *__restrict xs,
+                             const int16_t *__restrict ys,
+                             int16_t *__restrict hps, size_t n, Coord center,
+                             int radius, int amount) {
+  const float r2 = static_cast<float>(radius) * static_cast<float>(radius);
+  const size_t full = n - n % KERNEL_LANES;
+  uint32_t lanes[KERNEL_LANES] = {};
+  size_t i = 0;
+  for (; i < full; i += KERNEL_LANES) {
+    for (size_t k = 0; k < KERNEL_LANES; ++k) {
+      float dx = static_cast<float>(xs[i + k] - center.x);
+      float dy = static_cast<float>(ys[i + k] - center.y);
+      bool hit = dx * dx + dy * dy <= r2;
+      int left = hps[i + k] - (hit ? amount : 0);
+      hps[i + k] = static_cast<int16_t>(left < 0 ? 0 : left);
+      lanes[k] += hit;
+    }
+  }
+  size_t hits = 0;
+  for (; i < n; ++i) {
+    float dx = static_cast<float>(xs[i] - center.x);
+    float dy = static_cast<float>(ys[i] - center.y);
+    bool hit = dx * dx + dy * dy <= r2;
+    int left = hps[i] - (hit ? amount : 0);
+    hps[i] = static_cast<int16_t>(left < 0 ? 0 : left);
+    hits += hit;
+  }
+  for (uint32_t lane : lanes)
+    hits += lane;
+  return hits;
+}
+
+// How many entries have hp <= 0.
+inline size_t count_dead(const int16_t *__restrict hps, size_t n) {
+  const size_t full = n - n % KERNEL_LANES;
+  uint32_t lanes[KERNEL_LANES] = {};
+  size_t i = 0;
+  for (; i < full; i += KERNEL_LANES) {
+    for (size_t k = 0; k < KERNEL_LANES; ++k)
+      lanes[k] += hps[i + k] <= 0;
+  }
+  size_t dead = 0;
+  for (; i < n; ++i)
+    dead += hps[i] <= 0;
+  for (uint32_t lane : lanes)
+    dead += lane;
+  return dead;
+}
+
+// Refers to one mob across removals. Once the mob is removed the handle is
+// dead for good, even after its id is handed to a new mob.
+struct MobHandle {
+  uint32_t id = 0xFFFFFFFFu;
+  uint32_t generation = 0;
+
+  bool operator==(const MobHandle &other) const {
+    return id == other.id and generation == other.generation;
+  }
+};
+
+// Mobs as columns indexed 0..count()-1. Indices stay dense: remove() moves
+// the last mob into the freed index, so anything kept across a removal
+// should be a MobHandle.
+//
+// All columns share one allocation and one capacity, grown by doubling.
+// Each column starts on a 64-byte boundary, so the bulk kernels at the
+// bottom run over plain aligned arrays. y and hp are 16-bit; x stays 32-bit
+// because the world is unbounded sideways. The ground fits in y (see
+// World::set_bedrock_y); a mob placed beyond it is clamped to MIN_Y..MAX_Y.
+//
+// Positions must be changed through set_pos so `grid` follows them; after
+// writing the x/y columns directly, call rebuild_grid().
 struct MobStorage {
-  std::vector<int> x;
-  std::vector<int> y;
-  std::vector<int> hp;
-  std::vector<MobType> type;
-  std::vector<AIState> state;
+  static constexpr size_t NO_MOB = static_cast<size_t>(-1);
+  static constexpr int MIN_Y = std::numeric_limits<int16_t>::min();
+  static constexpr int MAX_Y = std::numeric_limits<int16_t>::max();
+
+  int32_t *x = nullptr;
+  int16_t *y = nullptr;
+  int16_t *hp = nullptr;
+  MobType *type = nullptr;
+  AIState *state = nullptr;
+  SimTier *tier = nullptr;
+  PathCache paths;
+  MobGrid grid;
+
+  // Mob indices per tier, from the last assign_tiers; stale after an add or
+  // remove.
+  std::vector<size_t> in_tier[static_cast<size_t>(SimTier::COUNT)];
+
+  MobStorage() = default;
+  MobStorage(const MobStorage &) = delete;
+  MobStorage &operator=(const MobStorage &) = delete;
+  ~MobStorage() { release(); }
+
+  MobHandle add(int mx, int my, int mhp, MobType mtype, AIState mstate) {
+    if (size == capacity)
+      reserve(std::max<size_t>(MIN_CAPACITY, capacity * 2));
+
+    uint32_t handle_id;
+    if (free_ids.empty()) {
+      handle_id = static_cast<uint32_t>(slot_of.size());
+      slot_of.push_back(0);
+      generation_of.push_back(0);
+    } else {
+      handle_id = free_ids.back();
+      free_ids.pop_back();
+    }
 
-  void add(int mx, int my, int mhp, MobType mtype, AIState mstate) {
-    x.push_back(mx);
-    y.push_back(my);
-    hp.push_back(mhp);
-    type.push_back(mtype);
-    state.push_back(mstate);
+    size_t i = size++;
+    x[i] = mx;
+    y[i] = clamp_y(my);
+    hp[i] = static_cast<int16_t>(mhp);
+    type[i] = mtype;
+    state[i] = mstate;
+    tier[i] = SimTier::FAR;
+    id[i] = handle_id;
+    slot_of[handle_id] = static_cast<uint32_t>(i);
+    paths.add();
+    grid.insert(i, {mx, y[i]});
+    return {handle_id, generation_of[handle_id]};
   }
 
   void remove(size_t index) {
-    if (index >= x.size())
+    if (index >= size)
       return;
-    size_t last = x.size() - 1;
+    ++generation_of[id[index]];
+    free_ids.push_back(id[index]);
+
+    size_t last = size - 1;
     if (index != last) {
       x[index] = x[last];
       y[index] = y[last];
       hp[index] = hp[last];
       type[index] = type[last];
       state[index] = state[last];
+      tier[index] = tier[last];
+      id[index] = id[last];
+      slot_of[id[index]] = static_cast<uint32_t>(index);
     }
-    x.pop_back();
-    y.pop_back();
-    hp.pop_back();
-    type.pop_back();
-    state.pop_back();
+    --size;
+    paths.remove(index);
+    grid.remove(index);
+  }
+
+  // Room for n mobs without reallocating.
+  void reserve(size_t n) {
+    if (n <= capacity)
+      return;
+    size_t bytes = 0;
+    for_each_column([&](auto *&column) {
+      bytes += column_bytes<std::remove_reference_t<decltype(*column)>>(n);
+    });
+
+    std::byte *fresh = static_cast<std::byte *>(
+        ::operator new(bytes, std::align_val_t{COLUMN_ALIGN}));
+    std::byte *cursor = fresh;
+    for_each_column([&](auto *&column) {
+      using T = std::remove_reference_t<decltype(*column)>;
+      T *moved = reinterpret_cast<T *>(cursor);
+      cursor += column_bytes<T>(n);
+      if (size > 0)
+        std::memcpy(moved, column, size * sizeof(T));
+      column = moved;
+    });
+
+    if (block)
+      ::operator delete(block, std::align_val_t{COLUMN_ALIGN});
+    block = fresh;
+    capacity = n;
   }
 
-  size_t count() const { return x.size(); }
+  size_t count() const { return size; }
+
+  MobHandle handle(size_t i) const { return {id[i], generation_of[id[i]]}; }
+
+  bool alive(MobHandle h) const {
+    return h.id < generation_of.size() and generation_of[h.id] == h.generation;
+  }
+
+  // Current index of the mob, or NO_MOB if it has been removed.
+  size_t index_of(MobHandle h) const {
+    return alive(h) ? slot_of[h.id] : NO_MOB;
+  }
 
   Coord get_pos(size_t idx) { return {x[idx], y[idx]}; }
 
+  static int16_t clamp_y(int wy) {
+    return static_cast<int16_t>(std::clamp(wy, MIN_Y, MAX_Y));
+  }
+
   void set_pos(size_t i, Coord pos) {
     x[i] = pos.x;
-    y[i] = pos.y;
+    y[i] = clamp_y(pos.y);
+    grid.move(i, {x[i], y[i]});
+  }
+
+  void rebuild_grid() {
+    grid.clear();
+    for (size_t i = 0; i < size; ++i) {
+      grid.insert(i, {x[i], y[i]});
+    }
+  }
+
+  // Put every mob in a distance band around `center`: VIEW inside the box of
+  // half-size half_w by half_h, MID within mid_radius, FAR beyond that.
+  void assign_tiers(Coord center, int half_w, int half_h, int mid_radius) {
+    for (std::vector<size_t> &members : in_tier)
+      members.clear();
+    int r2 = mid_radius * mid_radius;
+    for (size_t i = 0; i < size; ++i) {
+      int dx = x[i] - center.x;
+      int dy = y[i] - center.y;
+      SimTier t = SimTier::FAR;
+      if (std::abs(dx) <= half_w and std::abs(dy) <= half_h)
+        t = SimTier::VIEW;
+      else if (dx * dx + dy * dy <= r2)
+        t = SimTier::MID;
+      tier[i] = t;
+      in_tier[static_cast<size_t>(t)].push_back(i);
+    }
+  }
+
+  const std::vector<size_t> &mobs_in(SimTier t) const {
+    return in_tier[static_cast<size_t>(t)];
   }
 
   void set_hp(size_t i, int new_hp){
-    hp[i] = new_hp;
+    hp[i] = static_cast<int16_t>(new_hp);
   }
 
   void set_state(size_t i, AIState new_state){
     state[i] = new_state;
   }
-};
\ No newline at end of file
+
+  // ---- Bulk kernels, over whole columns ----
+
+  // Drop the mobs of tier `only` with index in [begin, end) straight down
+  // through AIR, by up to max_fall blocks. Only resident chunks are read; a
+  // mob above an unloaded chunk stays put. Returns how many moved.
+  size_t apply_gravity(const World &world, size_t begin, size_t end,
+                       int max_fall, SimTier only) {
+    ResidentBlocks blocks(world);
+    size_t moved = 0;
+    end = std::min(end, size);
+    for (size_t i = begin; i < end; ++i) {
+      if (tier[i] != only)
+        continue;
+      int fall = fall_distance(blocks, i, max_fall);
+      if (fall > 0) {
+        set_pos(i, {x[i], y[i] + fall});
+        ++moved;
+      }
+    }
+    return moved;
+  }
+
+  // apply_gravity without the move: writes where each of those mobs would
+  // land to out[i], and leaves the other entries alone. Const and reads
+  // resident chunks only, so ranges can be planned on several threads.
+  void plan_gravity(const World &world, size_t begin, size_t end,
+                    int max_fall, SimTier only, Coord *out) const {
+    ResidentBlocks blocks(world);
+    end = std::min(end, size);
+    for (size_t i = begin; i < end; ++i) {
+      if (tier[i] == only)
+        out[i] = {x[i], y[i] + fall_distance(blocks, i, max_fall)};
+    }
+  }
+
+  // Take `amount` hp (clamped at 0) from every mob within `radius` of
+  // `center`. Returns how many were hit. See damage_columns.
+  size_t damage_in_radius(Coord center, int radius, int amount) {
+    return damage_columns(x, y, hp, size, center, radius, amount);
+  }
+
+  // Remove every mob with hp <= 0 and return how many went. A vectorized
+  // count runs first, so the common nothing-died case is one pass over hp.
+  size_t cull_dead() {
+    size_t dead = count_dead(hp, size);
+    if (dead == 0)
+      return 0;
+
+    // Backwards: the mob remove() moves into index i has been checked.
+    for (size_t i = size; i-- > 0;) {
+      if (hp[i] <= 0)
+        remove(i);
+    }
+    return dead;
+  }
+
+private:
+  static constexpr size_t COLUMN_ALIGN = 64;
+  static constexpr size_t MIN_CAPACITY = 64;
+
+  uint32_t *id = nullptr; // handle id of the mob at each index
+  size_t size = 0;
+  size_t capacity = 0;
+  std::byte *block = nullptr;
+
+  std::vector<uint32_t> slot_of;       // per handle id: current index
+  std::vector<uint32_t> generation_of; // per handle id
+  std::vector<uint32_t> free_ids;
+
+  int fall_distance(ResidentBlocks &blocks, size_t i, int max_fall) const {
+    int fall = 0;
+    while (fall < max_fall and
+           blocks.get_block(x[i], y[i] + fall + 1) == BlockType::AIR) {
+      ++fall;
+    }
+    return fall;
+  }
+
+  template <typename T> static size_t column_bytes(size_t n) {
+    return (n * sizeof(T) + COLUMN_ALIGN - 1) & ~(COLUMN_ALIGN - 1);
+  }
+
+  template <typename F> void for_each_column(F &&f) {
+    std::apply([&](auto *&...column) { (f(column), ...); },
+               std::tie(x, y, hp, type, state, tier, id));
+  }
+
+  void release() {
+    if (block)
+      ::operator delete(block, std::align_val_t{COLUMN_ALIGN});
+    block = nullptr;
+  }
+};
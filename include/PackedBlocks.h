@@ -0,0 +1,310 @@
+#pragma once
+#include "BlockType.h"
+#include "Terrain.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+static_assert(CHUNK_SIZE == 32, "a half row of indices fits a uint64_t");
+
+using ChunkBlocks = std::array<std::array<BlockType, CHUNK_SIZE>, CHUNK_SIZE>;
+
+// A chunk's blocks in compact form: runs of uniform rows stored as one
+// block type, and the other (mixed) rows as packed indices into a palette of
+// the types that row uses. The same bytes are the in-memory form and the
+// save format.
+//
+//   runs, two bytes each {rows, value}, until CHUNK_SIZE rows are covered:
+//     value < COUNT:  `rows` uniform rows of BlockType(value)
+//     value == MIXED: `rows` mixed rows follow, each
+//                       1 byte   palette size P (2 .. BlockType::COUNT)
+//                       P bytes  the row's block types, ascending
+//                       CHUNK_SIZE * bits / 8 bytes of indices, bits the fewest
+//                       that hold P values; the index of block x starts at
+//                       bit x * bits, LSB first, and may cross into the next
+//                       byte
+//
+// Palettes are per row because the types cluster by depth: trees and grass
+// near the surface, stone, caves and ores below. Most mixed rows have 2-4
+// types and take 7-13 bytes instead of 32.
+//
+// A uniform chunk (all sky, all bedrock) is the single run {CHUNK_SIZE,
+// type}; in memory that is kept as a sentinel with no heap storage at all.
+class PackedBlocks {
+public:
+  static constexpr uint8_t MIXED = 0xFF;
+
+  static void encode(const ChunkBlocks &blocks, std::vector<uint8_t> &out) {
+    // Bit t of types[y]: row y holds BlockType(t). One bit set: uniform.
+    uint32_t types[CHUNK_SIZE];
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+      uint32_t mask = 0;
+      for (BlockType b : blocks[y])
+        mask |= 1u << static_cast<unsigned>(b);
+      types[y] = mask;
+    }
+    auto uniform = [&](int y) { return std::has_single_bit(types[y]); };
+
+    for (int y = 0; y < CHUNK_SIZE;) {
+      int end = y + 1;
+      if (uniform(y)) {
+        while (end < CHUNK_SIZE and types[end] == types[y])
+          ++end;
+        out.push_back(static_cast<uint8_t>(end - y));
+        out.push_back(static_cast<uint8_t>(blocks[y][0]));
+        y = end;
+        continue;
+      }
+      while (end < CHUNK_SIZE and !uniform(end))
+        ++end;
+      out.push_back(static_cast<uint8_t>(end - y));
+      out.push_back(MIXED);
+      for (; y < end; ++y)
+        encode_row(blocks[y], types[y], out);
+    }
+  }
+
+  // True if `data` is a well-formed encoding (every index inside the
+  // palette, nothing left over), so it can be handed to assign().
+  static bool valid(std::span<const uint8_t> data) {
+    const uint8_t COUNT = static_cast<uint8_t>(BlockType::COUNT);
+    size_t at = 0;
+    int rows = 0;
+    while (rows < CHUNK_SIZE) {
+      if (at + 2 > data.size())
+        return false;
+      int count = data[at];
+      uint8_t value = data[at + 1];
+      at += 2;
+      if (count == 0 or rows + count > CHUNK_SIZE)
+        return false;
+      rows += count;
+      if (value != MIXED) {
+        if (value >= COUNT)
+          return false;
+        continue;
+      }
+      for (int y = 0; y < count; ++y) {
+        if (at >= data.size())
+          return false;
+        uint8_t types = data[at];
+        size_t size = row_size(types);
+        if (types < 2 or types > COUNT or at + size > data.size())
+          return false;
+        for (size_t i = 1; i <= types; ++i) {
+          if (data[at + i] >= COUNT)
+            return false;
+        }
+        BlockType row[CHUNK_SIZE];
+        uint8_t palette[16];
+        std::fill(std::begin(palette), std::end(palette), COUNT);
+        std::copy_n(data.data() + at + 1, types, palette);
+        decode_indices_any(palette, data.data() + at + 1 + types,
+                           bits_for(types), row);
+        for (BlockType b : row) {
+          if (b == BlockType::COUNT)
+            return false;
+        }
+        at += size;
+      }
+    }
+    return at == data.size();
+  }
+
+  void pack(const ChunkBlocks &blocks) {
+    thread_local std::vector<uint8_t> scratch;
+    scratch.clear();
+    encode(blocks, scratch);
+    assign(scratch);
+  }
+
+  // `data` must be valid().
+  void assign(std::span<const uint8_t> data) {
+    if (data.size() == 2) {
+      bytes = std::vector<uint8_t>();
+      std::fill(std::begin(row_at), std::end(row_at), UNIFORM_ROW | data[1]);
+      return;
+    }
+    bytes.assign(data.begin(), data.end());
+    build_row_index();
+  }
+
+  // Unchecked: 0 <= x, y < CHUNK_SIZE.
+  BlockType get(int x, int y) const {
+    uint16_t r = row_at[y];
+    if (r & UNIFORM_ROW)
+      return static_cast<BlockType>(r & 0xFF);
+    const uint8_t *row = bytes.data() + r;
+    uint8_t types = row[0];
+    return static_cast<BlockType>(
+        row[1 + index_at(row + 1 + types, bits_for(types), x)]);
+  }
+
+  bool is_uniform_row(int y) const { return row_at[y] & UNIFORM_ROW; }
+
+  // Blocks x0 .. x0 + n - 1 of row y into `out`.
+  void read_row(int y, int x0, int n, BlockType *out) const {
+    uint16_t r = row_at[y];
+    if (r & UNIFORM_ROW) {
+      std::fill(out, out + n, static_cast<BlockType>(r & 0xFF));
+      return;
+    }
+    if (x0 == 0 and n == CHUNK_SIZE) {
+      decode_row(bytes.data() + r, out);
+      return;
+    }
+    BlockType row[CHUNK_SIZE];
+    decode_row(bytes.data() + r, row);
+    std::copy_n(row + x0, n, out);
+  }
+
+  void unpack(ChunkBlocks &out) const {
+    for (int y = 0; y < CHUNK_SIZE; ++y)
+      read_row(y, 0, CHUNK_SIZE, out[y].data());
+  }
+
+  // The encoding (see the top of the class).
+  std::span<const uint8_t> data() const {
+    if (bytes.empty())
+      return UNIFORM_CHUNK[row_at[0] & 0xFF];
+    return bytes;
+  }
+
+  bool is_uniform() const { return bytes.empty(); }
+  size_t heap_bytes() const { return bytes.capacity(); }
+
+private:
+  // row_at[y]: UNIFORM_ROW | block type, or the offset of the mixed row in
+  // `bytes` (always below UNIFORM_ROW: a chunk is at most
+  // CHUNK_SIZE * (3 + COUNT + CHUNK_SIZE / 2) bytes).
+  static constexpr uint16_t UNIFORM_ROW = 0x8000;
+
+  // The encoding of each uniform chunk, for data().
+  static constexpr auto UNIFORM_CHUNK = [] {
+    std::array<std::array<uint8_t, 2>, static_cast<size_t>(BlockType::COUNT)>
+        runs{};
+    for (size_t t = 0; t < runs.size(); ++t)
+      runs[t] = {CHUNK_SIZE, static_cast<uint8_t>(t)};
+    return runs;
+  }();
+
+  // Empty for a uniform chunk: row_at then holds its type in every row.
+  std::vector<uint8_t> bytes;
+  uint16_t row_at[CHUNK_SIZE] = {};
+
+  static uint8_t bits_for(uint8_t types) {
+    uint8_t bits = 0;
+    while ((1u << bits) < types)
+      ++bits;
+    return bits;
+  }
+
+  static size_t row_size(uint8_t types) {
+    return 1 + types + CHUNK_SIZE * bits_for(types) / 8;
+  }
+
+  static void encode_row(const std::array<BlockType, CHUNK_SIZE> &row,
+                         uint32_t types, std::vector<uint8_t> &out) {
+    uint8_t index_of[static_cast<size_t>(BlockType::COUNT)];
+    uint8_t count = static_cast<uint8_t>(std::popcount(types));
+    out.push_back(count);
+    for (uint8_t i = 0; types != 0; ++i, types &= types - 1) {
+      int t = std::countr_zero(types);
+      index_of[t] = i;
+      out.push_back(static_cast<uint8_t>(t));
+    }
+
+    size_t indices = out.size();
+    out.resize(indices + CHUNK_SIZE * bits_for(count) / 8);
+    switch (bits_for(count)) {
+    case 1:
+      return encode_indices<1>(row, index_of, out.data() + indices);
+    case 2:
+      return encode_indices<2>(row, index_of, out.data() + indices);
+    case 3:
+      return encode_indices<3>(row, index_of, out.data() + indices);
+    default:
+      return encode_indices<4>(row, index_of, out.data() + indices);
+    }
+  }
+
+  // The inverse of decode_indices.
+  template <int BITS>
+  static void encode_indices(const std::array<BlockType, CHUNK_SIZE> &row,
+                             const uint8_t *index_of, uint8_t *indices) {
+    for (int half = 0; half < 2; ++half) {
+      uint64_t word = 0;
+      for (int i = 0; i < CHUNK_SIZE / 2; ++i) {
+        uint64_t index =
+            index_of[static_cast<size_t>(row[half * CHUNK_SIZE / 2 + i])];
+        word |= index << (i * BITS);
+      }
+      std::memcpy(indices + half * 2 * BITS, &word, 2 * BITS);
+    }
+  }
+
+  // A whole mixed row. Each half row of indices is 2 * BITS bytes, starts
+  // on a byte and fits one 64-bit word; BITS is a template argument so the
+  // shifts are constants and the loops unroll.
+  template <int BITS>
+  static void decode_indices(const uint8_t *palette, const uint8_t *indices,
+                             BlockType *out) {
+    for (int half = 0; half < 2; ++half) {
+      uint64_t word = 0;
+      std::memcpy(&word, indices + half * 2 * BITS, 2 * BITS);
+      for (int i = 0; i < CHUNK_SIZE / 2; ++i) {
+        out[half * CHUNK_SIZE / 2 + i] = static_cast<BlockType>(
+            palette[(word >> (i * BITS)) & ((1u << BITS) - 1)]);
+      }
+    }
+  }
+
+  static void decode_row(const uint8_t *row, BlockType *out) {
+    decode_indices_any(row + 1, row + 1 + row[0], bits_for(row[0]), out);
+  }
+
+  static void decode_indices_any(const uint8_t *palette,
+                                 const uint8_t *indices, uint8_t bits,
+                                 BlockType *out) {
+    switch (bits) {
+    case 1:
+      return decode_indices<1>(palette, indices, out);
+    case 2:
+      return decode_indices<2>(palette, indices, out);
+    case 3:
+      return decode_indices<3>(palette, indices, out);
+    default:
+      return decode_indices<4>(palette, indices, out);
+    }
+  }
+
+  static uint8_t index_at(const uint8_t *packed, uint8_t bits, int x) {
+    int bit = x * bits;
+    unsigned word = packed[bit / 8];
+    if (bit % 8 + bits > 8)
+      word |= static_cast<unsigned>(packed[bit / 8 + 1]) << 8;
+    return (word >> (bit % 8)) & ((1u << bits) - 1);
+  }
+
+  void build_row_index() {
+    size_t at = 0;
+    for (int y = 0; y < CHUNK_SIZE;) {
+      int count = bytes[at];
+      uint8_t value = bytes[at + 1];
+      at += 2;
+      for (int end = y + count; y < end; ++y) {
+        if (value != MIXED) {
+          row_at[y] = UNIFORM_ROW | value;
+        } else {
+          row_at[y] = static_cast<uint16_t>(at);
+          at += row_size(bytes[at]);
+        }
+      }
+    }
+  }
+};
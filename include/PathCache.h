@@ -0,0 +1,223 @@
+#pragma once
+#include "Coord.h"
+#include "Pathfinding.h"
+#include "World.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+struct PathCacheStats {
+  size_t hits = 0;
+  size_t replans = 0;
+  // Why cached paths were dropped before they ran out.
+  size_t edited = 0;
+  size_t player_moved = 0;
+  size_t expired = 0;
+  size_t displaced = 0;
+};
+
+// The rest of each mob's path, indexed like the MobStorage columns.
+//
+// A path is kept as one byte per move (an index into PATH_DIRS) in a single
+// arena shared by all mobs; each mob owns a span of it. Replacing a path
+// appends a new span and leaves the old one as garbage, which is compacted
+// away once it makes up half the arena.
+//
+// A cached step is only handed out while the path is still good: the mob is
+// where the path left it, the player is within PLAYER_TOLERANCE of where the
+// path ends, the path is younger than MAX_AGE steps, and no block around the
+// rest of it has been edited (World reports edits through BlockListener, so
+// mining invalidates the paths it cuts immediately).
+class PathCache : public BlockListener {
+public:
+  static constexpr int PLAYER_TOLERANCE = 2;
+  static constexpr int MAX_AGE = 12;
+
+  void add() {
+    offset.push_back(0);
+    length.push_back(0);
+    cursor.push_back(0);
+    age.push_back(0);
+    valid.push_back(0);
+    expected.push_back({});
+    target.push_back({});
+    bounds.push_back({});
+  }
+
+  // Same swap-with-last as MobStorage::remove.
+  void remove(size_t i) {
+    drop(i);
+    size_t last = offset.size() - 1;
+    if (i != last) {
+      offset[i] = offset[last];
+      length[i] = length[last];
+      cursor[i] = cursor[last];
+      age[i] = age[last];
+      valid[i] = valid[last];
+      expected[i] = expected[last];
+      target[i] = target[last];
+      bounds[i] = bounds[last];
+    }
+    offset.pop_back();
+    length.pop_back();
+    cursor.pop_back();
+    age.pop_back();
+    valid.pop_back();
+    expected.pop_back();
+    target.pop_back();
+    bounds.pop_back();
+  }
+
+  // The next cached move for mob i standing at `pos` while the player is at
+  // `player`. False (and the path dropped) if it has to be replanned.
+  bool next_step(size_t i, Coord pos, Coord player, Coord &out) {
+    if (!valid[i])
+      return false;
+    if (pos != expected[i]) {
+      ++counters.displaced;
+      drop(i);
+      return false;
+    }
+    if (cursor[i] == length[i]) {
+      drop(i);
+      return false;
+    }
+    if (std::abs(player.x - target[i].x) > PLAYER_TOLERANCE or
+        std::abs(player.y - target[i].y) > PLAYER_TOLERANCE) {
+      ++counters.player_moved;
+      drop(i);
+      return false;
+    }
+    if (age[i] >= MAX_AGE) {
+      ++counters.expired;
+      drop(i);
+      return false;
+    }
+
+    ++counters.hits;
+    take_step(i, out);
+    return true;
+  }
+
+  // Cache `path` (path[0] is where mob i stands now) as a plan towards
+  // `player` and take its first move into `first`. Every step must be one
+  // of PATH_DIRS. False if the path has no moves.
+  bool store(size_t i, const std::vector<Coord> &path, Coord player,
+             Coord &first) {
+    drop(i);
+    ++counters.replans;
+    if (path.size() < 2)
+      return false;
+    if (garbage > 4096 and garbage * 2 > arena.size())
+      compact();
+
+    offset[i] = static_cast<uint32_t>(arena.size());
+    length[i] = static_cast<uint16_t>(path.size() - 1);
+    cursor[i] = 0;
+    age[i] = 0;
+    valid[i] = 1;
+    expected[i] = path[0];
+    target[i] = player;
+
+    Box box = {path[0].x, path[0].y, path[0].x, path[0].y};
+    for (size_t s = 1; s < path.size(); ++s) {
+      arena.push_back(move_index(path[s] - path[s - 1]));
+      box.x0 = std::min(box.x0, path[s].x);
+      box.y0 = std::min(box.y0, path[s].y);
+      box.x1 = std::max(box.x1, path[s].x);
+      box.y1 = std::max(box.y1, path[s].y);
+    }
+    bounds[i] = box;
+
+    take_step(i, first);
+    return true;
+  }
+
+  // A move into cell c depends on the blocks from (c.x - 1, c.y - 1) to
+  // (c.x + 1, c.y + 3), see can_step, so an edit there drops the path.
+  void on_blocks_changed(int x0, int y0, int x1, int y1) override {
+    for (size_t i = 0; i < valid.size(); ++i) {
+      if (!valid[i])
+        continue;
+      const Box &b = bounds[i];
+      if (x1 >= b.x0 - 1 and x0 <= b.x1 + 1 and y1 >= b.y0 - 1 and
+          y0 <= b.y1 + 3) {
+        ++counters.edited;
+        drop(i);
+      }
+    }
+  }
+
+  bool has_path(size_t i) const { return valid[i] != 0; }
+
+  // Moves left on mob i's cached path.
+  size_t remaining(size_t i) const {
+    return valid[i] ? length[i] - cursor[i] : 0;
+  }
+
+  size_t arena_bytes() const { return arena.size(); }
+  const PathCacheStats &stats() const { return counters; }
+
+private:
+  struct Box {
+    int x0, y0, x1, y1;
+  };
+
+  std::vector<uint8_t> arena;
+  std::vector<uint8_t> scratch; // compact() target, kept for its capacity
+  size_t garbage = 0;
+  PathCacheStats counters;
+
+  std::vector<uint32_t> offset;
+  std::vector<uint16_t> length;
+  std::vector<uint16_t> cursor;
+  std::vector<uint16_t> age;
+  std::vector<uint8_t> valid;
+  std::vector<Coord> expected; // where the next move starts from
+  std::vector<Coord> target;   // player position the path was planned to
+  std::vector<Box> bounds;     // cells the path runs through
+
+  void drop(size_t i) {
+    if (valid[i]) {
+      garbage += length[i];
+      valid[i] = 0;
+    }
+  }
+
+  void take_step(size_t i, Coord &out) {
+    out = expected[i] + PATH_DIRS[arena[offset[i] + cursor[i]]];
+    ++cursor[i];
+    ++age[i];
+    expected[i] = out;
+  }
+
+  static uint8_t move_index(Coord step) {
+    for (uint8_t k = 0; k < 6; ++k) {
+      if (PATH_DIRS[k] == step)
+        return k;
+    }
+    assert(false and "not a single move");
+    return 0;
+  }
+
+  // Copy the moves still ahead of each mob into `scratch`, back to back,
+  // and swap it in.
+  void compact() {
+    scratch.clear();
+    for (size_t i = 0; i < valid.size(); ++i) {
+      if (!valid[i])
+        continue;
+      uint32_t start = static_cast<uint32_t>(scratch.size());
+      scratch.insert(scratch.end(), arena.begin() + offset[i] + cursor[i],
+                     arena.begin() + offset[i] + length[i]);
+      offset[i] = start;
+      length[i] = static_cast<uint16_t>(length[i] - cursor[i]);
+      cursor[i] = 0;
+    }
+    arena.swap(scratch);
+    garbage = 0;
+  }
+};
@@ -1,11 +1,47 @@
 #pragma once
+#include "BlockAccessor.h"
 #include "BlockType.h"
 #include "Coord.h"
 #include "World.h"
+#include <algorithm>
+#include <cstdint>
 #include <queue>
 #include <unordered_map>
 #include <vector>
 
+// The moves a mob can make: walk left/right, fall, jump straight up, and
+// climb a ledge diagonally.
+inline const Coord PATH_DIRS[] = {{-1, 0}, {1, 0},  {0, 1},
+                                  {0, -1}, {-1, -1}, {1, -1}};
+
+// Whether a mob at `cur` may move by `dir`, given `block(x, y)`. The target
+// cell must be AIR; a diagonal climb needs a solid block beside `cur`, a jump
+// needs ground under `cur`, and a walk needs ground within 3 blocks below.
+template <typename BlockAt>
+inline bool can_step(BlockAt &&block, Coord cur, Coord dir) {
+  Coord nei = cur + dir;
+  if (block(nei.x, nei.y) != BlockType::AIR)
+    return false;
+
+  if (dir.y == -1 and dir.x != 0) {
+    return block(cur.x + dir.x, cur.y) != BlockType::AIR;
+  }
+
+  if (dir.y == -1 and dir.x == 0) {
+    return block(cur.x, cur.y + 1) != BlockType::AIR;
+  }
+
+  if (dir.y == 0) {
+    for (int fall = 1; fall <= 3; fall++) {
+      if (block(nei.x, nei.y + fall) != BlockType::AIR)
+        return true;
+    }
+    return false;
+  }
+
+  return true;
+}
+
 inline std::vector<Coord> bfs_findpath(Coord s, Coord tar, World &world,
                                        int max_depth = 50) {
 
@@ -13,6 +49,8 @@ inline std::vector<Coord> bfs_findpath(Coord s, Coord tar, World &world,
     return {s};
   }
 
+  BlockAccessor blocks(world);
+
   std::queue<Coord> qq;
   qq.push(s);
 
@@ -23,7 +61,7 @@ inline std::vector<Coord> bfs_findpath(Coord s, Coord tar, World &world,
   int current_level_rem = 1;
   int next_level_cnt = 0;
 
-  const Coord dirs[] = {{-1, 0}, {1, 0}, {0, 1}, {0, -1}, {-1, -1}, {1, -1}};
+  auto block_at = [&](int x, int y) { return blocks.get_block(x, y); };
 
   while (!qq.empty() and depth < max_depth) {
     Coord cur = qq.front();
@@ -33,39 +71,15 @@ inline std::vector<Coord> bfs_findpath(Coord s, Coord tar, World &world,
       break;
     }
 
-    for (const Coord &dir : dirs) {
+    for (const Coord &dir : PATH_DIRS) {
       Coord nei = cur + dir;
 
       if (parent.count(nei))
         continue;
 
-      if (world.get_block(nei.x, nei.y) != BlockType::AIR)
+      if (!can_step(block_at, cur, dir))
         continue;
 
-      if (dir.y == -1 and dir.x != 0) {
-        if (world.get_block(cur.x + dir.x, cur.y) == BlockType::AIR) {
-          continue;
-        }
-      }
-
-      if (dir.y == -1 and dir.x == 0) {
-        if (world.get_block(cur.x, cur.y + 1) == BlockType::AIR) {
-          continue;
-        }
-      }
-
-      if (dir.y == 0) {
-        bool has_ground = false;
-        for (int fall = 1; fall <= 3; fall++) {
-          if (world.get_block(nei.x, nei.y + fall) != BlockType::AIR) {
-            has_ground = true;
-            break;
-          }
-        }
-        if (!has_ground)
-          continue;
-      }
-
       parent[nei] = cur;
       qq.push(nei);
       ++next_level_cnt;
@@ -94,3 +108,131 @@ inline std::vector<Coord> bfs_findpath(Coord s, Coord tar, World &world,
 
   return path;
 }
+
+// Reusable state for bfs_findpath-style queries. Everything a search needs is
+// sized once for max_depth, so a query allocates nothing:
+// - cells live in a dense grid indexed by offset from the start (a path of
+//   at most max_depth moves can't leave that square);
+// - a cell counts as visited when its stamp equals the current generation,
+//   so starting a new search is one increment instead of a clear;
+// - the parent of a cell is the index of the move that reached it;
+// - the frontier is a power-of-two ring buffer of grid indices.
+class PathContext {
+public:
+  explicit PathContext(int max_depth = 50) { reserve(max_depth); }
+
+  // Same result as bfs_findpath(s, tar, world, max_depth). The returned path
+  // is owned by the context and valid until the next query.
+  const std::vector<Coord> &find_path(Coord s, Coord tar, World &world,
+                                      int max_depth = 50) {
+    path.clear();
+    if (s == tar) {
+      path.push_back(s);
+      return path;
+    }
+    if (max_depth > capacity_depth)
+      reserve(max_depth);
+
+    if (++generation == 0) {
+      std::fill(stamp.begin(), stamp.end(), 0u);
+      generation = 1;
+    }
+
+    BlockAccessor blocks(world);
+    auto block_at = [&](int x, int y) { return blocks.get_block(x, y); };
+
+    origin = {s.x - capacity_depth, s.y - capacity_depth};
+    size_t head = 0, tail = 0;
+    int start = index_of(s);
+    stamp[start] = generation;
+    queue[tail++ & queue_mask] = start;
+
+    int depth = 0;
+    int current_level_rem = 1;
+    int next_level_cnt = 0;
+    bool found = false;
+
+    while (head != tail and depth < max_depth) {
+      int cur_index = queue[head++ & queue_mask];
+      Coord cur = coord_of(cur_index);
+      ++expanded;
+
+      if (cur == tar) {
+        break;
+      }
+
+      for (uint8_t k = 0; k < 6; ++k) {
+        Coord nei = cur + PATH_DIRS[k];
+        int j = index_of(nei);
+        if (stamp[j] == generation)
+          continue;
+        if (!can_step(block_at, cur, PATH_DIRS[k]))
+          continue;
+
+        stamp[j] = generation;
+        parent_dir[j] = k;
+        queue[tail++ & queue_mask] = j;
+        ++next_level_cnt;
+        found = found or nei == tar;
+      }
+
+      --current_level_rem;
+      if (current_level_rem == 0) {
+        depth++;
+        current_level_rem = next_level_cnt;
+        next_level_cnt = 0;
+      }
+    }
+
+    if (!found)
+      return path;
+
+    Coord cur = tar;
+    while (cur != s) {
+      path.push_back(cur);
+      cur = cur - PATH_DIRS[parent_dir[index_of(cur)]];
+    }
+    path.push_back(s);
+    std::reverse(path.begin(), path.end());
+    return path;
+  }
+
+  // Nodes taken off the queue over all queries.
+  size_t nodes_expanded() const { return expanded; }
+
+private:
+  int capacity_depth = 0;
+  int side = 0;
+  Coord origin;
+  uint32_t generation = 0;
+  size_t queue_mask = 0;
+  size_t expanded = 0;
+
+  std::vector<uint32_t> stamp;
+  std::vector<uint8_t> parent_dir;
+  std::vector<int> queue;
+  std::vector<Coord> path;
+
+  void reserve(int max_depth) {
+    capacity_depth = max_depth;
+    side = 2 * max_depth + 1;
+    size_t cells = static_cast<size_t>(side) * side;
+    stamp.assign(cells, 0u);
+    parent_dir.assign(cells, 0);
+    size_t ring = 1;
+    while (ring < cells)
+      ring <<= 1;
+    queue.assign(ring, 0);
+    queue_mask = ring - 1;
+    path.reserve(max_depth + 1);
+    generation = 0;
+  }
+
+  int index_of(Coord c) const {
+    return (c.y - origin.y) * side + (c.x - origin.x);
+  }
+
+  Coord coord_of(int i) const {
+    return {origin.x + i % side, origin.y + i / side};
+  }
+};
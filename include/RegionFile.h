@@ -0,0 +1,399 @@
+#pragma once
+#include "BlockType.h"
+#include "Coord.h"
+#include "PackedBlocks.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file through the page cache: nothing is read
+// until a page is touched. Closed (size 0) if the file can't be mapped.
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  explicit MappedFile(const std::filesystem::path &path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER bytes;
+    if (GetFileSizeEx(file, &bytes) and bytes.QuadPart > 0) {
+      HANDLE mapping =
+          CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping) {
+        // The view keeps the mapping and the file alive on its own.
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view) {
+          base = static_cast<const std::byte *>(view);
+          length = static_cast<size_t>(bytes.QuadPart);
+        }
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 and info.st_size > 0) {
+      void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                        MAP_SHARED, fd, 0);
+      if (view != MAP_FAILED) {
+        base = static_cast<const std::byte *>(view);
+        length = static_cast<size_t>(info.st_size);
+      }
+    }
+    ::close(fd);
+#endif
+  }
+
+  MappedFile(MappedFile &&other) noexcept
+      : base(std::exchange(other.base, nullptr)),
+        length(std::exchange(other.length, 0)) {}
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      base = std::exchange(other.base, nullptr);
+      length = std::exchange(other.length, 0);
+    }
+    return *this;
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { unmap(); }
+
+  const std::byte *data() const { return base; }
+  size_t size() const { return length; }
+  bool is_open() const { return base != nullptr; }
+
+private:
+  const std::byte *base = nullptr;
+  size_t length = 0;
+
+  void unmap() {
+    if (!base)
+      return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(const_cast<std::byte *>(base), length);
+#endif
+    base = nullptr;
+    length = 0;
+  }
+};
+
+// Write `size` bytes to `path` (replacing it) and flush them to the disk
+// before returning.
+inline bool write_file_synced(const std::filesystem::path &path,
+                              const void *data, size_t size) {
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  DWORD written = 0;
+  bool ok = WriteFile(file, data, static_cast<DWORD>(size), &written,
+                      nullptr) and
+            written == size and FlushFileBuffers(file);
+  CloseHandle(file);
+  return ok;
+#else
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  const char *bytes = static_cast<const char *>(data);
+  bool ok = true;
+  while (ok and size > 0) {
+    ssize_t n = ::write(fd, bytes, size);
+    ok = n > 0;
+    if (ok) {
+      bytes += n;
+      size -= static_cast<size_t>(n);
+    }
+  }
+  ok = ok and ::fsync(fd) == 0;
+  ok = ::close(fd) == 0 and ok;
+  return ok;
+#endif
+}
+
+// Rename `temp` over `path` in one step: a crash leaves either the old file
+// or the new one. On POSIX the directory is synced too, so the rename itself
+// is on disk when this returns.
+inline bool replace_file(const std::filesystem::path &temp,
+                         const std::filesystem::path &path) {
+  std::error_code error;
+  std::filesystem::rename(temp, path, error);
+  if (error)
+    return false;
+#ifndef _WIN32
+  std::filesystem::path dir = path.parent_path();
+  int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    ::fsync(fd);
+    ::close(fd);
+  }
+#endif
+  return true;
+}
+
+// Region files: REGION_SIZE x REGION_SIZE chunks per file, named
+// r.<rx>.<ry>.bin. Layout (host byte order):
+//
+//   uint32 magic, uint32 version
+//   REGION_CHUNKS x {uint32 offset, uint32 length}, slot = ly * SIZE + lx;
+//                   offset 0 means the chunk was never saved
+//   payloads from REGION_DATA_START on
+//
+// A payload is the chunk in PackedBlocks form, the same bytes a packed Chunk
+// holds in memory, so loading one copies it straight out of the mapping
+// without decoding anything. Region files are written to a temporary file,
+// synced and renamed over the old one.
+constexpr int REGION_SHIFT = 5;
+constexpr int REGION_SIZE = 1 << REGION_SHIFT;
+constexpr int REGION_CHUNKS = REGION_SIZE * REGION_SIZE;
+constexpr uint32_t REGION_MAGIC = 0x4E474552; // "REGN"
+constexpr uint32_t REGION_VERSION = 2;
+constexpr size_t REGION_DATA_START = 12288;
+
+struct RegionHeader {
+  uint32_t magic;
+  uint32_t version;
+  struct Slot {
+    uint32_t offset;
+    uint32_t length;
+  } slots[REGION_CHUNKS];
+};
+
+static_assert(sizeof(RegionHeader) <= REGION_DATA_START);
+
+// A chunk to save: its position and its blocks in PackedBlocks form.
+struct SavedChunk {
+  Coord pos;
+  std::span<const uint8_t> bytes;
+};
+
+struct RegionStats {
+  size_t regions_written = 0;
+  size_t chunks_written = 0;
+  size_t bytes_written = 0;
+  size_t chunks_loaded = 0;
+};
+
+// The saved chunks of one world, in region files under `dir`. Region files
+// are mapped on first use and stay mapped until they are rewritten.
+//
+// One thread may save while another loads: loads copy the payload out under
+// a lock, and saves hold that lock only to swap the mapping for the new
+// file, never while writing or syncing. Saves are serialized.
+//
+// Only chunks that differ from what the generator makes need to be here;
+// World saves the ones edited since they were generated or loaded (see
+// World::save_dirty_chunks).
+class RegionStore {
+public:
+  explicit RegionStore(std::filesystem::path directory)
+      : dir(std::move(directory)) {}
+
+  // The saved chunk `pos` as PackedBlocks bytes, or empty if it was never
+  // saved (or its payload is damaged).
+  std::vector<uint8_t> find(Coord pos) {
+    std::lock_guard<std::mutex> lock(maps_mutex);
+    std::span<const uint8_t> payload = stored(region(region_of(pos)), pos);
+    if (payload.empty() or !PackedBlocks::valid(payload))
+      return {};
+    ++counters.chunks_loaded;
+    return {payload.begin(), payload.end()};
+  }
+
+  // Write `saved` into their region files, keeping every chunk already
+  // there that isn't being replaced. Each region is written to a temporary
+  // file and renamed over the old one, so a failed save leaves it intact.
+  // False if any region couldn't be written. Waits for a save running on
+  // another thread.
+  bool save(std::vector<SavedChunk> saved) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    return save_locked(std::move(saved));
+  }
+
+  // save(), or false straight away if another thread is saving.
+  bool try_save(std::vector<SavedChunk> saved) {
+    std::unique_lock<std::mutex> lock(write_mutex, std::try_to_lock);
+    return lock.owns_lock() and save_locked(std::move(saved));
+  }
+
+  RegionStats stats() const {
+    std::lock_guard<std::mutex> lock(maps_mutex);
+    return counters;
+  }
+  const std::filesystem::path &directory() const { return dir; }
+
+  static Coord region_of(Coord chunk) {
+    return {chunk.x >> REGION_SHIFT, chunk.y >> REGION_SHIFT};
+  }
+
+private:
+  std::filesystem::path dir;
+  // Guards `regions` and `counters`. Only savers, holding write_mutex,
+  // remove mappings.
+  mutable std::mutex maps_mutex;
+  std::mutex write_mutex;
+  // Missing or invalid region files are cached as closed mappings too.
+  std::unordered_map<Coord, MappedFile, CoordHash> regions;
+  RegionStats counters;
+
+  bool save_locked(std::vector<SavedChunk> saved) {
+    std::sort(saved.begin(), saved.end(),
+              [](const SavedChunk &a, const SavedChunk &b) {
+                return pack_coord(region_of(a.pos)) <
+                       pack_coord(region_of(b.pos));
+              });
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+
+    bool ok = true;
+    for (size_t begin = 0; begin < saved.size();) {
+      Coord r = region_of(saved[begin].pos);
+      size_t end = begin;
+      while (end < saved.size() and region_of(saved[end].pos) == r)
+        ++end;
+      ok = write_region(r, saved.data() + begin, saved.data() + end) and ok;
+      begin = end;
+    }
+    return ok;
+  }
+
+  static int slot_of(Coord chunk) {
+    return (chunk.y & (REGION_SIZE - 1)) * REGION_SIZE +
+           (chunk.x & (REGION_SIZE - 1));
+  }
+
+  static const RegionHeader &header(const MappedFile &file) {
+    return *reinterpret_cast<const RegionHeader *>(file.data());
+  }
+
+  std::filesystem::path path_of(Coord r) const {
+    return dir / ("r." + std::to_string(r.x) + "." + std::to_string(r.y) +
+                  ".bin");
+  }
+
+  const MappedFile &region(Coord r) {
+    auto it = regions.find(r);
+    if (it == regions.end()) {
+      MappedFile file(path_of(r));
+      if (!valid(file))
+        file = MappedFile();
+      it = regions.emplace(r, std::move(file)).first;
+    }
+    return it->second;
+  }
+
+  // Checked once per mapping, so find() can trust every slot.
+  static bool valid(const MappedFile &file) {
+    if (file.size() < REGION_DATA_START)
+      return false;
+    const RegionHeader &h = header(file);
+    if (h.magic != REGION_MAGIC or h.version != REGION_VERSION)
+      return false;
+    for (const RegionHeader::Slot &slot : h.slots) {
+      if (slot.offset == 0)
+        continue;
+      if (slot.offset < REGION_DATA_START or slot.length == 0 or
+          slot.offset + static_cast<size_t>(slot.length) > file.size())
+        return false;
+    }
+    return true;
+  }
+
+  static std::span<const uint8_t> stored(const MappedFile &file, Coord pos) {
+    if (!file.is_open())
+      return {};
+    const RegionHeader::Slot &slot = header(file).slots[slot_of(pos)];
+    if (slot.offset == 0)
+      return {};
+    return {reinterpret_cast<const uint8_t *>(file.data()) + slot.offset,
+            slot.length};
+  }
+
+  bool write_region(Coord r, const SavedChunk *begin,
+                    const SavedChunk *end) {
+    // Map nodes don't move, and this mapping stays until we erase it below.
+    const MappedFile *old;
+    {
+      std::lock_guard<std::mutex> lock(maps_mutex);
+      old = &region(r);
+    }
+    std::span<const uint8_t> kept[REGION_CHUNKS];
+    for (int s = 0; s < REGION_CHUNKS; ++s) {
+      int lx = s % REGION_SIZE, ly = s / REGION_SIZE;
+      kept[s] = stored(*old, {r.x * REGION_SIZE + lx, r.y * REGION_SIZE + ly});
+    }
+    for (const SavedChunk *c = begin; c != end; ++c)
+      kept[slot_of(c->pos)] = {};
+
+    RegionHeader h = {};
+    h.magic = REGION_MAGIC;
+    h.version = REGION_VERSION;
+    std::vector<uint8_t> out(REGION_DATA_START);
+
+    // Kept payloads first (they point into `old`), then the new ones.
+    for (int s = 0; s < REGION_CHUNKS; ++s) {
+      if (kept[s].empty())
+        continue;
+      h.slots[s] = {static_cast<uint32_t>(out.size()),
+                    static_cast<uint32_t>(kept[s].size())};
+      out.insert(out.end(), kept[s].begin(), kept[s].end());
+    }
+    for (const SavedChunk *c = begin; c != end; ++c) {
+      h.slots[slot_of(c->pos)] = {static_cast<uint32_t>(out.size()),
+                                  static_cast<uint32_t>(c->bytes.size())};
+      out.insert(out.end(), c->bytes.begin(), c->bytes.end());
+    }
+    std::memcpy(out.data(), &h, sizeof(h));
+
+    std::filesystem::path path = path_of(r);
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    if (!write_file_synced(temp, out.data(), out.size()))
+      return false;
+
+    // The old mapping has to go before the rename (Windows won't replace a
+    // mapped file), and would be stale after it anyway.
+    std::lock_guard<std::mutex> lock(maps_mutex);
+    regions.erase(r);
+    if (!replace_file(temp, path))
+      return false;
+
+    ++counters.regions_written;
+    counters.chunks_written += static_cast<size_t>(end - begin);
+    counters.bytes_written += out.size();
+    return true;
+  }
+};
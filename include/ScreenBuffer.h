@@ -1,75 +1,268 @@
 #pragma once
 #include "Pixel.h"
-#include <array>
+#include <algorithm>
+#include <csignal>
 #include <iostream>
 #include <string>
+#include <vector>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// Default size, used until the terminal has been queried.
 constexpr int SCREEN_WIDTH = 80;
 constexpr int SCREEN_HEIGHT = 24;
 
+// Current terminal size in cells. False if stdout isn't a terminal.
+inline bool query_terminal_size(int &width, int &height) {
+#ifdef _WIN32
+  CONSOLE_SCREEN_BUFFER_INFO info;
+  if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+    return false;
+  width = info.srWindow.Right - info.srWindow.Left + 1;
+  height = info.srWindow.Bottom - info.srWindow.Top + 1;
+#else
+  winsize ws{};
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 or ws.ws_col == 0)
+    return false;
+  width = ws.ws_col;
+  height = ws.ws_row;
+#endif
+  return width > 0 and height > 0;
+}
+
+#ifndef _WIN32
+// Set from the SIGWINCH handler; fit_to_terminal only re-queries the size
+// after one arrived.
+inline volatile std::sig_atomic_t terminal_resized = 1;
+
+inline void handle_sigwinch(int) { terminal_resized = 1; }
+#endif
+
 class ScreenBuffer {
 private:
-  std::array<std::array<Pixel, SCREEN_WIDTH>, SCREEN_HEIGHT> buffer;
+  int width = SCREEN_WIDTH;
+  int height = SCREEN_HEIGHT;
+
+  // Row-major, width * height.
+  std::vector<Pixel> buffer;
+
+  // What the terminal currently shows (valid once has_front is set).
+  std::vector<Pixel> front;
+  bool has_front = false;
+  bool needs_clear = false;
+
+  // Redraw everything once at least this fraction of cells changed.
+  float full_redraw_ratio = 0.5f;
+
+  std::string frame;
+  size_t bytes_written = 0;
+  size_t frames_presented = 0;
+  size_t full_redraws = 0;
+
+  // Unchanged cells shorter than this between two changed runs are rewritten
+  // rather than skipped: a cursor move costs about as much.
+  static constexpr int MAX_SKIP_GAP = 6;
 
 public:
-  void clear() {
-    Pixel empty{' ', Color::WHITE};
+  ScreenBuffer() {
+    resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    needs_clear = false;
+  }
 
-    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
-      for (int x = 0; x < SCREEN_WIDTH; ++x) {
-        buffer[y][x] = empty;
-      }
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+  // The only place the buffers are (re)allocated. The next frame is a full
+  // redraw that also clears whatever the old size left on the terminal.
+  void resize(int w, int h) {
+    width = w < 1 ? 1 : w;
+    height = h < 1 ? 1 : h;
+    buffer.assign(static_cast<size_t>(width) * height, Pixel{});
+    front.assign(buffer.size(), Pixel{});
+    frame.reserve(buffer.size() * 12);
+    has_front = false;
+    needs_clear = true;
+  }
+
+  // Match the terminal size. Cheap when nothing changed; returns true if the
+  // buffer was resized.
+  bool fit_to_terminal() {
+#ifndef _WIN32
+    static bool handler_installed = false;
+    if (!handler_installed) {
+      std::signal(SIGWINCH, handle_sigwinch);
+      handler_installed = true;
     }
+    if (!terminal_resized)
+      return false;
+    terminal_resized = 0;
+#endif
+    int w, h;
+    if (!query_terminal_size(w, h) or (w == width and h == height))
+      return false;
+    resize(w, h);
+    return true;
+  }
+
+  void clear() {
+    Pixel empty{' ', Color::WHITE};
+    std::fill(buffer.begin(), buffer.end(), empty);
   }
 
   void set_pixel(int x, int y, Pixel p) {
-    if (x < 0 or x >= SCREEN_WIDTH or y < 0 or y >= SCREEN_HEIGHT) {
+    if (x < 0 or x >= width or y < 0 or y >= height) {
       return;
     }
 
-    buffer[y][x] = p;
+    buffer[y * width + x] = p;
   }
 
   Pixel get_pixel(int x, int y) const {
-    if (x < 0 or x >= SCREEN_WIDTH or y < 0 or y >= SCREEN_HEIGHT) {
+    if (x < 0 or x >= width or y < 0 or y >= height) {
       return {' ', Color::WHITE};
     }
-    return buffer[y][x];
+    return buffer[y * width + x];
   }
 
-  void render() const {
-    std::string frame;
-    frame.reserve(SCREEN_WIDTH * SCREEN_HEIGHT * 12);
+  void render() {
+    compose_frame(frame);
+    if (!frame.empty()) {
+      std::cout << frame << std::flush;
+    }
+  }
 
-    frame += "\033[H";
+  // Build the escape sequence that turns the previously presented frame
+  // into the current one, and remember the current one as presented. Empty
+  // if nothing changed.
+  void compose_frame(std::string &out) {
+    out.clear();
 
-    Color last_color = Color::WHITE;
+    size_t damaged = 0;
+    if (has_front) {
+      for (size_t i = 0; i < buffer.size(); ++i) {
+        damaged += !same(buffer[i], front[i]);
+      }
+    }
 
-    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
-      for (int x = 0; x < SCREEN_WIDTH; ++x) {
-        const Pixel &p = buffer[y][x];
+    if (!has_front or damaged >= full_redraw_ratio * buffer.size()) {
+      compose_full(out);
+      ++full_redraws;
+    } else if (damaged > 0) {
+      compose_diff(out);
+    }
 
-        if (p.color != last_color) {
-          frame += "\033[";
+    front = buffer; // same size, so no allocation
+    has_front = true;
+    bytes_written += out.size();
+    ++frames_presented;
+  }
+
+  // Forget what the terminal shows; the next frame is a full redraw. Call
+  // after anything else has written to the terminal.
+  void invalidate() { has_front = false; }
 
-          frame += std::to_string(static_cast<int>(p.color));
+  void set_full_redraw_ratio(float ratio) { full_redraw_ratio = ratio; }
 
-          frame += "m";
+  size_t total_bytes_written() const { return bytes_written; }
+  size_t total_frames() const { return frames_presented; }
+  size_t total_full_redraws() const { return full_redraws; }
 
+  void draw_text(int x, int y, const std::string &text,
+                 Color color = Color::WHITE) {
+    for (int i = 0; i < static_cast<int>(text.size()); ++i) {
+      set_pixel(x + i, y, {text[i], color});
+    }
+  }
+
+private:
+  static bool same(const Pixel &a, const Pixel &b) {
+    return a.ch == b.ch and a.color == b.color;
+  }
+
+  static void append_color(std::string &out, Color color) {
+    out += "\033[";
+    out += std::to_string(static_cast<int>(color));
+    out += "m";
+  }
+
+  // Rows are separated by \r\n with none after the last, so a buffer as tall
+  // as the terminal doesn't scroll it.
+  void compose_full(std::string &out) {
+    if (needs_clear) {
+      out += "\033[2J";
+      needs_clear = false;
+    }
+    out += "\033[H";
+
+    Color last_color = Color::WHITE;
+
+    for (int y = 0; y < height; ++y) {
+      if (y > 0)
+        out += "\r\n";
+      const Pixel *row = &buffer[y * width];
+      for (int x = 0; x < width; ++x) {
+        const Pixel &p = row[x];
+
+        if (p.color != last_color) {
+          append_color(out, p.color);
           last_color = p.color;
         }
-        frame += p.ch;
+        out += p.ch;
       }
-      frame += "\n";
     }
-    frame += "\033[m";
-    std::cout << frame;
+    out += "\033[m";
   }
 
-  void draw_text(int x, int y, const std::string &text,
-                 Color color = Color::WHITE) {
-    for (int i = 0; i < static_cast<int>(text.size()); ++i) {
-      set_pixel(x + i, y, {text[i], color});
+  // Only the changed runs of each row: a cursor move to the start of the
+  // run, then its cells, with color codes only where the color changes.
+  void compose_diff(std::string &out) const {
+    Color last_color = Color::WHITE;
+
+    for (int y = 0; y < height; ++y) {
+      const Pixel *now = &buffer[y * width];
+      const Pixel *was = &front[y * width];
+      int x = 0;
+      while (x < width) {
+        if (same(now[x], was[x])) {
+          ++x;
+          continue;
+        }
+
+        // Extend the run over short unchanged gaps.
+        int end = x + 1;
+        int gap = 0;
+        for (int i = end; i < width and gap < MAX_SKIP_GAP; ++i) {
+          if (same(now[i], was[i])) {
+            ++gap;
+          } else {
+            end = i + 1;
+            gap = 0;
+          }
+        }
+
+        out += "\033[";
+        out += std::to_string(y + 1);
+        out += ";";
+        out += std::to_string(x + 1);
+        out += "H";
+        for (int i = x; i < end; ++i) {
+          if (now[i].color != last_color) {
+            append_color(out, now[i].color);
+            last_color = now[i].color;
+          }
+          out += now[i].ch;
+        }
+        x = end;
+      }
     }
+    out += "\033[m";
   }
-};
\ No newline at end of file
+};
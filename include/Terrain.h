@@ -1,11 +1,27 @@
 #pragma once
 #include "BlockType.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 
 constexpr int CHUNK_SIZE = 32;
+constexpr int CHUNK_SHIFT = 5;
+constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+static_assert(CHUNK_SIZE == 1 << CHUNK_SHIFT, "CHUNK_SIZE is 2^CHUNK_SHIFT");
+
+// World y grows downwards. The surface lies in chunk row 0, between
+// MIN_SURFACE_Y and MAX_SURFACE_Y; above it is sky, below it stone and caves
+// down to the bedrock floor, and solid BEDROCK under that.
+constexpr int MIN_SURFACE_Y = 2;
+constexpr int MAX_SURFACE_Y = CHUNK_SIZE - 6;
+// Highest row a tree can reach: a trunk of up to 5 blocks on the highest
+// surface, with leaves 2 rows above its top.
+constexpr int TERRAIN_TOP_Y = MIN_SURFACE_Y - 7;
+constexpr int DEFAULT_BEDROCK_Y = 4 * CHUNK_SIZE - 1;
+constexpr int TERRAIN_SEED = 42;
 
 inline float hash_noise(int x, int seed) {
   unsigned int n = static_cast<unsigned int>(x) * 374761393u +
@@ -110,9 +126,25 @@ inline float fbm_2d(float x, float y, int seed, int octaves = 4) {
   return value / max_amplitude;
 }
 
-inline void generate_chunk_terrain(
+// out[i] = fbm(wx0 + i, seed) for i in [0, n).
+inline void fbm_batch(int wx0, int n, int seed, float *out, int octaves = 4) {
+  for (int i = 0; i < n; ++i)
+    out[i] = fbm(static_cast<float>(wx0 + i), seed, octaves);
+}
+
+// out[i] = fbm_2d(wx0 + i, y, seed) for i in [0, n).
+inline void fbm_2d_batch(int wx0, int n, float y, int seed, float *out,
+                         int octaves = 4) {
+  for (int i = 0; i < n; ++i)
+    out[i] = fbm_2d(static_cast<float>(wx0 + i), y, seed, octaves);
+}
+
+// Per-cell scalar generator. Kept as the reference the batched generator must
+// match block-for-block, and as the benchmark baseline.
+inline void generate_chunk_terrain_reference(
     std::array<std::array<BlockType, CHUNK_SIZE>, CHUNK_SIZE> &blocks, int cx,
-    int seed = 42) {
+    int cy, int seed = TERRAIN_SEED, int bedrock_y = DEFAULT_BEDROCK_Y) {
+  const int wy0 = cy * CHUNK_SIZE;
   for (int x = 0; x < CHUNK_SIZE; ++x) {
     int wx = cx * CHUNK_SIZE + x;
 
@@ -120,31 +152,32 @@ inline void generate_chunk_terrain(
 
     int surface_y = 8 + static_cast<int>(noise * 8);
 
-    if (surface_y < 2)
-      surface_y = 2;
-    if (surface_y > CHUNK_SIZE - 6)
-      surface_y = CHUNK_SIZE - 6;
+    if (surface_y < MIN_SURFACE_Y)
+      surface_y = MIN_SURFACE_Y;
+    if (surface_y > MAX_SURFACE_Y)
+      surface_y = MAX_SURFACE_Y;
 
     for (int y = 0; y < CHUNK_SIZE; ++y) {
-      if (y < surface_y) {
+      int wy = wy0 + y;
+      if (wy < surface_y) {
         blocks[y][x] = BlockType::AIR;
-      } else if (y == surface_y) {
+      } else if (wy == surface_y) {
         blocks[y][x] = BlockType::GRASS;
-      } else if (y < surface_y + 4) {
+      } else if (wy < surface_y + 4) {
         blocks[y][x] = BlockType::DIRT;
-      } else if (y < CHUNK_SIZE - 1) {
+      } else if (wy < bedrock_y) {
 
         float cave =
-            fbm_2d(static_cast<float>(wx), static_cast<float>(y), seed + 777);
+            fbm_2d(static_cast<float>(wx), static_cast<float>(wy), seed + 777);
 
         if (cave > 0.55f) {
           blocks[y][x] = BlockType::AIR;
         } else {
-          float ore_noise = hash_noise(wx * 100 + y, seed + 99);
+          float ore_noise = hash_noise(wx * 100 + wy, seed + 99);
 
-          if (ore_noise > 0.95f and y > 20) {
+          if (ore_noise > 0.95f and wy > 20) {
             blocks[y][x] = BlockType::DIAMOND;
-          } else if (ore_noise > 0.88f and y > 15) {
+          } else if (ore_noise > 0.88f and wy > 15) {
             blocks[y][x] = BlockType::GOLD;
           } else if (ore_noise > 0.80f) {
             blocks[y][x] = BlockType::IRON;
@@ -161,19 +194,118 @@ inline void generate_chunk_terrain(
     if (tree_noise > 0.85f) {
       int trunk_height = 3 + static_cast<int>(hash_noise(wx, seed + 666) * 3);
       for (int t = 1; t <= trunk_height; t++) {
-        int ty = surface_y - t;
-        if (ty >= 0) {
+        int ty = surface_y - t - wy0;
+        if (ty >= 0 && ty < CHUNK_SIZE) {
           blocks[ty][x] = BlockType::WOOD;
         }
       }
-      int top = surface_y - trunk_height;
+      int top = surface_y - trunk_height - wy0;
       for (int ly = top - 2; ly <= top; ly++) {
         for (int lx = x - 1; lx <= x + 1; lx++) {
-          if (ly >= 0 && lx >= 0 && lx < CHUNK_SIZE) {
+          if (ly >= 0 && ly < CHUNK_SIZE && lx >= 0 && lx < CHUNK_SIZE) {
             blocks[ly][lx] = BlockType::LEAF;
           }
         }
       }
     }
   }
-}
\ No newline at end of file
+}
+
+// Same terrain as generate_chunk_terrain_reference, but all noise is evaluated
+// up front in whole rows (fbm_batch, fbm_2d_batch), in straight loops that
+// overlap well, instead of one cell at a time between the block decisions.
+// The column loop below is unchanged apart from reading the precomputed
+// values. Chunks wholly above the trees or below the bedrock floor are
+// filled without any noise.
+inline void generate_chunk_terrain(
+    std::array<std::array<BlockType, CHUNK_SIZE>, CHUNK_SIZE> &blocks, int cx,
+    int cy, int seed = TERRAIN_SEED, int bedrock_y = DEFAULT_BEDROCK_Y) {
+  const int wx0 = cx * CHUNK_SIZE;
+  const int wy0 = cy * CHUNK_SIZE;
+  if (wy0 + CHUNK_SIZE <= TERRAIN_TOP_Y or wy0 >= bedrock_y) {
+    BlockType fill = wy0 >= bedrock_y ? BlockType::BEDROCK : BlockType::AIR;
+    for (auto &row : blocks)
+      row.fill(fill);
+    return;
+  }
+
+  float surface_noise[CHUNK_SIZE];
+  fbm_batch(wx0, CHUNK_SIZE, seed, surface_noise);
+
+  int surface[CHUNK_SIZE];
+  int first_cave_y = MAX_SURFACE_Y + 4;
+  for (int x = 0; x < CHUNK_SIZE; ++x) {
+    int surface_y = 8 + static_cast<int>(surface_noise[x] * 8);
+    if (surface_y < MIN_SURFACE_Y)
+      surface_y = MIN_SURFACE_Y;
+    if (surface_y > MAX_SURFACE_Y)
+      surface_y = MAX_SURFACE_Y;
+    surface[x] = surface_y;
+    if (surface_y + 4 < first_cave_y)
+      first_cave_y = surface_y + 4;
+  }
+
+  // Local rows [cave_begin, cave_end) can hold caves.
+  int cave_begin = std::max(first_cave_y - wy0, 0);
+  int cave_end = std::min(bedrock_y - wy0, CHUNK_SIZE);
+  float cave[CHUNK_SIZE][CHUNK_SIZE];
+  for (int y = cave_begin; y < cave_end; ++y) {
+    fbm_2d_batch(wx0, CHUNK_SIZE, static_cast<float>(wy0 + y), seed + 777,
+                 cave[y]);
+  }
+
+  for (int x = 0; x < CHUNK_SIZE; ++x) {
+    int wx = wx0 + x;
+    int surface_y = surface[x];
+
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+      int wy = wy0 + y;
+      if (wy < surface_y) {
+        blocks[y][x] = BlockType::AIR;
+      } else if (wy == surface_y) {
+        blocks[y][x] = BlockType::GRASS;
+      } else if (wy < surface_y + 4) {
+        blocks[y][x] = BlockType::DIRT;
+      } else if (wy < bedrock_y) {
+        if (cave[y][x] > 0.55f) {
+          blocks[y][x] = BlockType::AIR;
+        } else {
+          float ore_noise = hash_noise(wx * 100 + wy, seed + 99);
+
+          if (ore_noise > 0.95f and wy > 20) {
+            blocks[y][x] = BlockType::DIAMOND;
+          } else if (ore_noise > 0.88f and wy > 15) {
+            blocks[y][x] = BlockType::GOLD;
+          } else if (ore_noise > 0.80f) {
+            blocks[y][x] = BlockType::IRON;
+          } else {
+            blocks[y][x] = BlockType::STONE;
+          }
+        }
+      } else {
+        blocks[y][x] = BlockType::BEDROCK;
+      }
+    }
+
+    // Leaves spill into column x + 1 here and are then overwritten when that
+    // column is filled, exactly as in the reference generator.
+    float tree_noise = hash_noise(wx, seed + 155);
+    if (tree_noise > 0.85f) {
+      int trunk_height = 3 + static_cast<int>(hash_noise(wx, seed + 666) * 3);
+      for (int t = 1; t <= trunk_height; t++) {
+        int ty = surface_y - t - wy0;
+        if (ty >= 0 && ty < CHUNK_SIZE) {
+          blocks[ty][x] = BlockType::WOOD;
+        }
+      }
+      int top = surface_y - trunk_height - wy0;
+      for (int ly = top - 2; ly <= top; ly++) {
+        for (int lx = x - 1; lx <= x + 1; lx++) {
+          if (ly >= 0 && ly < CHUNK_SIZE && lx >= 0 && lx < CHUNK_SIZE) {
+            blocks[ly][lx] = BlockType::LEAF;
+          }
+        }
+      }
+    }
+  }
+}
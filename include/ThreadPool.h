@@ -0,0 +1,144 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed set of worker threads, one task deque per worker. A worker pops the
+// newest task from its own deque and, when that is empty, steals the oldest
+// task from another worker's deque. Submitted tasks are spread round-robin.
+class WorkStealingPool {
+public:
+  using Task = std::function<void()>;
+
+  static unsigned default_thread_count() {
+    unsigned hw = std::thread::hardware_concurrency();
+    return std::clamp(hw > 1 ? hw - 1 : 1u, 1u, 4u);
+  }
+
+  explicit WorkStealingPool(unsigned threads = default_thread_count()) {
+    if (threads == 0)
+      threads = 1;
+    for (unsigned i = 0; i < threads; ++i) {
+      queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+      workers.emplace_back([this, i] { worker_loop(i); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : workers) {
+      t.join();
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  void submit(Task task) {
+    size_t target = next_queue++ % queues.size();
+    {
+      std::lock_guard<std::mutex> lock(queues[target]->mutex);
+      queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      ++pending;
+    }
+    wake.notify_one();
+  }
+
+  size_t thread_count() const { return workers.size(); }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  size_t next_queue = 0; // only touched by the submitting thread
+
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  size_t pending = 0;
+  bool stopping = false;
+
+  bool try_pop(size_t self, Task &out) {
+    {
+      Queue &own = *queues[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        out = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    for (size_t k = 1; k < queues.size(); ++k) {
+      Queue &victim = *queues[(self + k) % queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        out = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker_loop(size_t self) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stopping or pending > 0; });
+        if (stopping)
+          return;
+        --pending;
+      }
+      // pending counted one task for us; it is in some deque by now.
+      Task task;
+      while (!try_pop(self, task)) {
+        std::this_thread::yield();
+      }
+      task();
+    }
+  }
+};
+
+// Runs fn(0) .. fn(tasks - 1) on `pool` and waits for all of them. Without a
+// pool they run here, in order. fn must not submit to the same pool.
+template <typename F>
+inline void run_tasks(WorkStealingPool *pool, size_t tasks, F &&fn) {
+  if (!pool or tasks <= 1) {
+    for (size_t t = 0; t < tasks; ++t)
+      fn(t);
+    return;
+  }
+  std::latch done(static_cast<std::ptrdiff_t>(tasks));
+  for (size_t t = 0; t < tasks; ++t) {
+    pool->submit([&fn, &done, t] {
+      fn(t);
+      done.count_down();
+    });
+  }
+  done.wait();
+}
+
+// The t-th of `tasks` contiguous, nearly equal slices of [0, n).
+inline std::pair<size_t, size_t> task_range(size_t t, size_t tasks, size_t n) {
+  return {n * t / tasks, n * (t + 1) / tasks};
+}
@@ -7,6 +7,8 @@ public:
   virtual ~Window() = default;
 
   virtual bool handle_input(const InputState &input) = 0;
+  // Advance the simulation by one fixed step of dt seconds.
+  virtual void update(double dt) { (void)dt; }
   virtual void render(ScreenBuffer &screen) = 0;
 
   virtual bool is_opaque() const { return true; }
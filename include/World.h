@@ -1,68 +1,606 @@
 #pragma once
 #include "BlockType.h"
 #include "Chunk.h"
+#include "ChunkProvider.h"
+#include "ChunkTable.h"
 #include "Coord.h"
 #include "Pixel.h"
+#include "RegionFile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <span>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Written by World::peek_region for cells whose chunk is still generating.
+constexpr BlockType UNLOADED_BLOCK = BlockType::COUNT;
+
+// Told about block edits by a World it is registered with (see
+// World::add_block_listener), right after they happen.
+class BlockListener {
+public:
+  virtual ~BlockListener() = default;
+
+  // Blocks in [x0, x1] x [y0, y1], bounds included, have changed.
+  virtual void on_blocks_changed(int x0, int y0, int x1, int y1) = 0;
+};
+
+struct BlockChange {
+  int x, y;
+  BlockType old_type, new_type;
+};
+
+// Append-only log of block edits, numbered from 0 in the order they happened.
+// Each reader keeps its own cursor (the number of the first entry it hasn't
+// seen) and catches up with read(), so readers never get in each other's
+// way. trim() frees entries every reader is past; a reader still behind them
+// gets false from read() and must rescan whatever it keeps instead.
+class ChangeJournal {
+public:
+  void append(const BlockChange &change) { entries.push_back(change); }
+
+  uint64_t begin() const { return first; }
+  uint64_t end() const { return first + entries.size(); }
+
+  // f(change) for every entry from `cursor` on, then moves `cursor` to end().
+  template <typename F> bool read(uint64_t &cursor, F &&f) const {
+    if (cursor < first)
+      return false;
+    for (uint64_t n = cursor; n < end(); ++n)
+      f(entries[static_cast<size_t>(n - first)]);
+    cursor = end();
+    return true;
+  }
+
+  // Drop the entries before `upto`.
+  void trim(uint64_t upto) {
+    upto = std::min(upto, end());
+    if (upto <= first)
+      return;
+    entries.erase(entries.begin(),
+                  entries.begin() + static_cast<ptrdiff_t>(upto - first));
+    first = upto;
+  }
+
+private:
+  std::vector<BlockChange> entries;
+  uint64_t first = 0;
+};
+
+// See World::residency. Evicted edited chunks wait in the spill, encoded,
+// until the region store takes them (for good, without a store); they don't
+// count as resident.
+struct ResidencyStats {
+  size_t resident_chunks = 0;
+  size_t resident_bytes = 0;
+  size_t spilled_chunks = 0;
+  size_t spilled_bytes = 0;
+  size_t evicted_clean = 0;  // dropped, to be generated again
+  size_t evicted_edited = 0; // encoded into the spill first
+  size_t reloads = 0;        // loaded from the spill or the region store
+};
+
+// What a save writes: the chunks edited since the last save and the spill,
+// taken by World::snapshot_dirty. The chunks' blocks are shared copy-on-write
+// (Chunk::share_blocks), so taking a snapshot copies nothing and the world
+// can keep changing while another thread packs and writes it; hand it back
+// to World::finish_save once it is written. The snapshot is taken, finished
+// and dropped on the world's thread: chunks decide whether to copy their
+// blocks from the shared count, which only that thread may lower.
+struct SaveSnapshot {
+  struct Edited {
+    Coord pos;
+    std::shared_ptr<const ChunkBlocks> blocks; // until finish_save
+    PackedBlocks packed;                       // from write()
+  };
+  std::vector<Edited> edited;
+  std::vector<std::pair<Coord, std::vector<uint8_t>>> spilled;
+  // The journal's end when the snapshot was taken: every edit before it is
+  // in the snapshot.
+  uint64_t journal_end = 0;
+
+  bool empty() const { return edited.empty() and spilled.empty(); }
+
+  // Pack the edited chunks and save everything to `store`. Reads nothing
+  // but the snapshot and writes nothing but the store, so it can run on any
+  // thread.
+  bool write(RegionStore &store) {
+    std::vector<SavedChunk> saved;
+    for (Edited &e : edited) {
+      e.packed.pack(*e.blocks);
+      saved.push_back({e.pos, e.packed.data()});
+    }
+    for (const auto &[pos, bytes] : spilled)
+      saved.push_back({pos, bytes});
+    return saved.empty() or store.save(std::move(saved));
+  }
+};
 
 class World {
 private:
-  std::unordered_map<Coord, std::unique_ptr<Chunk>, CoordHash> chunks;
+  ChunkTable chunks;
+  ChunkProvider provider;
+
+  bool waited_this_frame = false;
+  bool placeholder_this_frame = false;
+  size_t frames_waited = 0;
+  size_t frames_with_placeholders = 0;
+
+  std::vector<BlockListener *> listeners;
+  ChangeJournal journal;
+  RegionStore *store = nullptr;
+
+  // Counted up by begin_frame; chunks remember the frame they were last
+  // handed out in.
+  uint32_t frame = 0;
+  size_t budget = 0;
+  int bedrock_y = DEFAULT_BEDROCK_Y;
+  // Sum of the resident chunks' memory_bytes(), kept by the chunks.
+  size_t resident_bytes = 0;
+  std::unordered_map<Coord, std::vector<uint8_t>, CoordHash> spilled;
+  ResidencyStats counts;
 
 public:
+  // Always returns the real chunk. If it is not resident yet this blocks:
+  // either on the worker already generating it, or by generating it here.
   Chunk &get_chunk(Coord pos) {
-    auto it = chunks.find(pos);
-    if (it == chunks.end()) {
-      chunks[pos] = std::make_unique<Chunk>(pos);
-      return *chunks[pos];
+    if (Chunk *chunk = chunks.find(pos)) {
+      chunk->touch(frame);
+      return *chunk;
+    }
+    if (Chunk *saved = load_saved(pos))
+      return *saved;
+    waited_this_frame = true;
+    if (provider.is_pending(pos)) {
+      provider.wait_for(pos, [this](std::unique_ptr<Chunk> chunk) {
+        insert_chunk(std::move(chunk));
+      });
+      return *chunks.find(pos);
+    }
+    return add_chunk(pos, pos, bedrock_y);
+  }
+
+  // Non-blocking lookup for the render path. Returns nullptr (and queues the
+  // chunk) if it is not resident yet.
+  const Chunk *peek_chunk(Coord pos) {
+    if (Chunk *chunk = chunks.find(pos)) {
+      chunk->touch(frame);
+      return chunk;
+    }
+    if (const Chunk *saved = load_saved(pos))
+      return saved;
+    provider.request(pos);
+    placeholder_this_frame = true;
+    return nullptr;
+  }
+
+  // Resident chunk or nullptr, with no side effects (peek_chunk queues
+  // missing chunks). Safe to call from several threads as long as nothing
+  // inserts or drops chunks meanwhile.
+  const Chunk *find_chunk(Coord pos) const { return chunks.find(pos); }
+
+  bool peek_block(int wx, int wy, BlockType &out) {
+    const Chunk *chunk = peek_chunk(world_to_chunk(wx, wy));
+    if (!chunk)
+      return false;
+    out = chunk->get_block(local_coord(wx), local_coord(wy));
+    return true;
+  }
+
+  // Copy the w x h rectangle starting at (x0, y0) into `out`, row-major with
+  // row stride w. Works chunk by chunk, one row read per chunk row. Blocks on
+  // missing chunks like get_block.
+  void copy_region(int x0, int y0, int w, int h, BlockType *out) {
+    copy_region_impl<true>(x0, y0, w, h, out);
+  }
+
+  // Non-blocking copy_region: cells in chunks that aren't resident yet are
+  // set to UNLOADED_BLOCK (and the chunks queued). False if any were.
+  bool peek_region(int x0, int y0, int w, int h, BlockType *out) {
+    return copy_region_impl<false>(x0, y0, w, h, out);
+  }
+
+  // Padded variants: `out` is (w + 2) x (h + 2) and also holds the 1-cell
+  // border around the rectangle, so every cell of the rectangle can check its
+  // 4 neighbours in the buffer. Cell (x, y) is at
+  // out[(y - y0 + 1) * (w + 2) + (x - x0 + 1)].
+  void copy_region_padded(int x0, int y0, int w, int h, BlockType *out) {
+    copy_region_impl<true>(x0 - 1, y0 - 1, w + 2, h + 2, out);
+  }
+
+  bool peek_region_padded(int x0, int y0, int w, int h, BlockType *out) {
+    return copy_region_impl<false>(x0 - 1, y0 - 1, w + 2, h + 2, out);
+  }
+
+  // peek_region as the player sees it: ores without AIR next to them come
+  // back as STONE (one exposure-mask bit test per ore).
+  bool peek_visible_region(int x0, int y0, int w, int h, BlockType *out) {
+    return copy_region_impl<false, true>(x0, y0, w, h, out);
+  }
+
+  // Queue generation of the chunks around (wx, wy): the 3 chunk rows around
+  // the player, PREFETCH_RADIUS columns either side, plus `lookahead` more in
+  // direction `dir` (+1 or -1). Workers run their newest task first, so the
+  // columns ahead are queued before the ones near the player.
+  void prefetch_around(int wx, int wy, int dir, int lookahead) {
+    const int PREFETCH_RADIUS = 2;
+    Coord center = world_to_chunk(wx, wy);
+    for (int step = PREFETCH_RADIUS + lookahead; step >= -PREFETCH_RADIUS;
+         --step) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        Coord pos = {center.x + dir * step, center.y + dy};
+        if (!chunks.contains(pos) and !load_saved(pos)) {
+          provider.request(pos);
+        }
+      }
     }
-    return *it->second;
   }
 
+  // Call once per frame: moves finished chunks into the world and closes the
+  // stall accounting for the previous frame.
+  void begin_frame() {
+    ++frame;
+    provider.drain([this](std::unique_ptr<Chunk> chunk) {
+      insert_chunk(std::move(chunk));
+    });
+    if (waited_this_frame)
+      ++frames_waited;
+    if (placeholder_this_frame)
+      ++frames_with_placeholders;
+    waited_this_frame = false;
+    placeholder_this_frame = false;
+  }
+
+  size_t frames_waited_on_generation() const { return frames_waited; }
+  size_t frames_showing_placeholders() const {
+    return frames_with_placeholders;
+  }
+  size_t chunks_prefetched() const { return provider.requested_count(); }
+
   BlockType get_block(int wx, int wy) {
     Coord chunk_pos = world_to_chunk(wx, wy);
-    int cx = wx % CHUNK_SIZE;
-    int cy = wy % CHUNK_SIZE;
-    if (cx < 0)
-      cx += CHUNK_SIZE;
-    if (cy < 0)
-      cy += CHUNK_SIZE;
-    return get_chunk(chunk_pos).get_block(cx, cy);
+    return get_chunk(chunk_pos).get_block(local_coord(wx), local_coord(wy));
   }
 
+  // Also updates the ore exposure of the edited cell and its 4 neighbours,
+  // including neighbours across a chunk border, and logs the edit in the
+  // change journal (unless the block was already `type`).
   void set_block(int wx, int wy, BlockType type) {
-    Coord chunk_pos = world_to_chunk(wx, wy);
-    int cx = wx % CHUNK_SIZE;
-    int cy = wy % CHUNK_SIZE;
-    if (cx < 0)
-      cx += CHUNK_SIZE;
-    if (cy < 0)
-      cy += CHUNK_SIZE;
-    get_chunk(chunk_pos).set_block(cx, cy, type);
+    Coord pos = world_to_chunk(wx, wy);
+    int lx = local_coord(wx);
+    int ly = local_coord(wy);
+    Chunk &chunk = get_chunk(pos);
+    BlockType old_type = chunk.get_block(lx, ly);
+    bool was_clean = !chunk.is_dirty();
+    chunk.set_block(lx, ly, type);
+    if (old_type != type) {
+      // A spilled copy is older than the chunk now; the chunk is saved or
+      // spilled again from here.
+      if (was_clean and !spilled.empty())
+        spilled.erase(pos);
+      chunk.note_edit(journal.end());
+      journal.append({wx, wy, old_type, type});
+    }
+
+    refresh_exposure(pos, ly - 1, ly + 1);
+    if (lx == 0)
+      refresh_exposure({pos.x - 1, pos.y}, ly, ly);
+    if (lx == CHUNK_SIZE - 1)
+      refresh_exposure({pos.x + 1, pos.y}, ly, ly);
+    if (ly == 0)
+      refresh_exposure({pos.x, pos.y - 1}, CHUNK_SIZE - 1, CHUNK_SIZE - 1);
+    if (ly == CHUNK_SIZE - 1)
+      refresh_exposure({pos.x, pos.y + 1}, 0, 0);
+
+    for (BlockListener *listener : listeners)
+      listener->on_blocks_changed(wx, wy, wx, wy);
+  }
+
+  // The listener must outlive its registration.
+  void add_block_listener(BlockListener *listener) {
+    listeners.push_back(listener);
+  }
+
+  void remove_block_listener(BlockListener *listener) {
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener),
+                    listeners.end());
+  }
+
+  // World row of the bedrock floor; everything below it is BEDROCK. It must
+  // be below the dirt (MAX_SURFACE_Y + 4) and fit the 16-bit mob rows (see
+  // MobStorage); false, and nothing changed, otherwise. Only applies to
+  // chunks generated after the call, so set it before the world is used.
+  bool set_bedrock_y(int wy) {
+    if (wy < MAX_SURFACE_Y + 4 or wy > std::numeric_limits<int16_t>::max())
+      return false;
+    bedrock_y = wy;
+    provider.set_bedrock_y(wy);
+    return true;
+  }
+  int get_bedrock_y() const { return bedrock_y; }
+
+  // Chunks saved in `region_store` are loaded from it instead of being
+  // generated. The store must outlive the world (or be detached with
+  // nullptr).
+  void set_region_store(RegionStore *region_store) { store = region_store; }
+
+  // Save every chunk edited since it was generated, loaded or last saved,
+  // and the spill, then mark the chunks clean and pack them again. False
+  // (and nothing marked clean) if the store couldn't write them all.
+  bool save_dirty_chunks() {
+    if (!store)
+      return false;
+    SaveSnapshot snapshot = snapshot_dirty();
+    if (!snapshot.write(*store))
+      return false;
+    finish_save(snapshot);
+    return true;
+  }
+
+  // save_dirty_chunks in two halves, for saving on another thread: copy
+  // what it would write, and once that is written, mark it saved. Chunks
+  // edited after the snapshot stay dirty, and so does the spill if it
+  // changed.
+  SaveSnapshot snapshot_dirty() {
+    SaveSnapshot snapshot;
+    chunks.for_each([&](Chunk &chunk) {
+      if (chunk.is_dirty())
+        snapshot.edited.push_back(
+            {chunk.get_position(), chunk.share_blocks(), {}});
+    });
+    std::vector<SavedChunk> spill;
+    collect_spilled(spill);
+    for (const SavedChunk &c : spill)
+      snapshot.spilled.emplace_back(
+          c.pos, std::vector<uint8_t>(c.bytes.begin(), c.bytes.end()));
+    snapshot.journal_end = journal.end();
+    return snapshot;
+  }
+
+  // A chunk that is still dirty with no edits since the snapshot is the one
+  // in it (a chunk evicted and reloaded meanwhile comes back clean), so it
+  // is clean now and takes the packed blocks the save made. The snapshot
+  // lets go of the shared blocks.
+  void finish_save(SaveSnapshot &snapshot) {
+    for (SaveSnapshot::Edited &e : snapshot.edited) {
+      e.blocks.reset();
+      Chunk *chunk = chunks.find(e.pos);
+      if (chunk and chunk->is_dirty() and
+          chunk->last_edit() < snapshot.journal_end) {
+        chunk->clear_dirty();
+        chunk->pack(std::move(e.packed));
+      }
+    }
+    for (const auto &[pos, bytes] : snapshot.spilled) {
+      auto it = spilled.find(pos);
+      if (it != spilled.end() and it->second == bytes)
+        spilled.erase(it);
+    }
+  }
+
+  // Bytes of resident chunks evict_to_budget keeps them under; 0 (the
+  // default) keeps every chunk.
+  void set_memory_budget(size_t bytes) { budget = bytes; }
+
+  // If the resident chunks are over budget, evict the least recently used
+  // ones until they are 1/8 under it, so this doesn't run every frame.
+  // Chunks within EVICT_KEEP_RADIUS chunks of (wx, wy) and chunks used this
+  // frame are kept. Clean chunks are dropped; edited ones go to the spill,
+  // which is then written to the region store if there is one. Returns the
+  // number evicted.
+  //
+  // Evicted chunks are destroyed, so call this where no Chunk pointers,
+  // BlockAccessors or ResidentBlocks are live.
+  size_t evict_to_budget(int wx, int wy) {
+    const int EVICT_KEEP_RADIUS = 3;
+    if (budget == 0 or resident_bytes <= budget)
+      return 0;
+
+    struct Candidate {
+      uint32_t last_use;
+      int distance;
+      Coord pos;
+    };
+    Coord center = world_to_chunk(wx, wy);
+    std::vector<Candidate> candidates;
+    chunks.for_each([&](Chunk &chunk) {
+      Coord pos = chunk.get_position();
+      int distance = std::max(std::abs(pos.x - center.x),
+                              std::abs(pos.y - center.y));
+      if (distance > EVICT_KEEP_RADIUS and chunk.last_use() != frame)
+        candidates.push_back({chunk.last_use(), distance, pos});
+    });
+    // Oldest first; among chunks last used together, the farthest.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) {
+                if (a.last_use != b.last_use)
+                  return a.last_use < b.last_use;
+                return a.distance > b.distance;
+              });
+
+    const size_t target = budget - budget / 8;
+    size_t evicted = 0;
+    for (const Candidate &c : candidates) {
+      if (resident_bytes <= target)
+        break;
+      evict(*chunks.find(c.pos));
+      ++evicted;
+    }
+    if (store and !spilled.empty())
+      flush_spilled();
+    return evicted;
+  }
+
+  // Write the spill to the region store. False if there is no store, it is
+  // busy saving on another thread, or it couldn't write them all (the spill
+  // is kept then, for the next try or the next save).
+  bool flush_spilled() {
+    if (!store)
+      return false;
+    std::vector<SavedChunk> saved;
+    collect_spilled(saved);
+    if (!saved.empty() and !store->try_save(std::move(saved)))
+      return false;
+    spilled.clear();
+    return true;
+  }
+
+  ResidencyStats residency() const {
+    ResidencyStats stats = counts;
+    stats.resident_chunks = chunks.size();
+    stats.resident_bytes = chunk_memory_bytes();
+    stats.spilled_chunks = spilled.size();
+    for (const auto &[pos, bytes] : spilled)
+      stats.spilled_bytes += bytes.capacity();
+    return stats;
   }
 
+  // Every edit made through set_block. Readers keep their own cursor; the
+  // owner of the world decides when to trim.
+  const ChangeJournal &changes() const { return journal; }
+  void trim_changes(uint64_t upto) { journal.trim(upto); }
+
+  // Non-blocking: false if the chunk isn't resident.
+  bool is_exposed(int wx, int wy) const {
+    const Chunk *chunk = chunks.find(world_to_chunk(wx, wy));
+    return chunk and chunk->is_exposed(local_coord(wx), local_coord(wy));
+  }
+
+  // Resident chunks only (see evict_to_budget).
   size_t chunk_count() const { return chunks.size(); }
 
-private:
+  // Bytes held by resident chunks (see Chunk::memory_bytes).
+  size_t chunk_memory_bytes() const { return resident_bytes; }
+
+  // CHUNK_SIZE is a power of two, so floor division and the matching
+  // non-negative remainder are a shift and a mask (also for negative w).
+  static int local_coord(int w) { return w & CHUNK_MASK; }
+
   static Coord world_to_chunk(int wx, int wy) {
-    int cx, cy;
+    return {wx >> CHUNK_SHIFT, wy >> CHUNK_SHIFT};
+  }
 
-    if (wx >= 0) {
-      cx = wx / CHUNK_SIZE;
-    } else {
-      cx = (wx - CHUNK_SIZE + 1) / CHUNK_SIZE;
+private:
+  template <bool BLOCKING, bool HIDE_BURIED_ORE = false>
+  bool copy_region_impl(int x0, int y0, int w, int h, BlockType *out) {
+    if (w <= 0 or h <= 0)
+      return true;
+    bool complete = true;
+    const int x1 = x0 + w;
+    const int y1 = y0 + h;
+    for (int cy = y0 >> CHUNK_SHIFT; cy <= (y1 - 1) >> CHUNK_SHIFT; ++cy) {
+      int ry0 = std::max(y0, cy * CHUNK_SIZE);
+      int ry1 = std::min(y1, (cy + 1) * CHUNK_SIZE);
+      for (int cx = x0 >> CHUNK_SHIFT; cx <= (x1 - 1) >> CHUNK_SHIFT; ++cx) {
+        int rx0 = std::max(x0, cx * CHUNK_SIZE);
+        int run = std::min(x1, (cx + 1) * CHUNK_SIZE) - rx0;
+        const Chunk *chunk =
+            BLOCKING ? &get_chunk({cx, cy}) : peek_chunk({cx, cy});
+        complete = complete and chunk;
+        for (int y = ry0; y < ry1; ++y) {
+          BlockType *dst = out + static_cast<size_t>(y - y0) * w + (rx0 - x0);
+          if (chunk) {
+            chunk->read_row(local_coord(y), local_coord(rx0), run, dst);
+            if (HIDE_BURIED_ORE) {
+              uint32_t shown =
+                  chunk->exposed_row(local_coord(y)) >> local_coord(rx0);
+              for (int i = 0; i < run; ++i) {
+                if (is_ore(dst[i]) and !((shown >> i) & 1u))
+                  dst[i] = BlockType::STONE;
+              }
+            }
+          } else {
+            std::fill(dst, dst + run, UNLOADED_BLOCK);
+          }
+        }
+      }
+    }
+    return complete;
+  }
+
+  template <typename... Args> Chunk &add_chunk(Coord pos, Args &&...args) {
+    Chunk &chunk = chunks.emplace(pos, std::forward<Args>(args)...);
+    chunk.count_memory_in(&resident_bytes);
+    chunk.touch(frame);
+    link_exposure(chunk);
+    return chunk;
+  }
+
+  // Page the chunk in from the spill, or from the region store if it was
+  // saved there. A spilled chunk stays in the spill until it is saved or
+  // edited again: once reloaded it is clean, and evicting it again just
+  // drops it.
+  Chunk *load_saved(Coord pos) {
+    if (auto it = spilled.find(pos); it != spilled.end()) {
+      ++counts.reloads;
+      return &add_chunk(pos, pos, std::span<const uint8_t>(it->second));
     }
+    if (!store)
+      return nullptr;
+    std::vector<uint8_t> saved = store->find(pos);
+    if (saved.empty())
+      return nullptr;
+    ++counts.reloads;
+    return &add_chunk(pos, pos, std::span<const uint8_t>(saved));
+  }
+
+  // Never replaces a resident chunk (it may already have been edited), and
+  // a freshly generated chunk loses to a saved one: it may have been queued
+  // before the chunk was evicted.
+  void insert_chunk(std::unique_ptr<Chunk> chunk) {
+    Coord pos = chunk->get_position();
+    if (!chunks.contains(pos) and !load_saved(pos))
+      add_chunk(pos, std::move(*chunk));
+  }
 
-    if (wy >= 0) {
-      cy = wy / CHUNK_SIZE;
+  void evict(Chunk &chunk) {
+    Coord pos = chunk.get_position();
+    if (chunk.is_dirty()) {
+      std::vector<uint8_t> &bytes = spilled[pos];
+      bytes.clear();
+      chunk.encode(bytes);
+      bytes.shrink_to_fit();
+      ++counts.evicted_edited;
     } else {
-      cy = (wy - CHUNK_SIZE + 1) / CHUNK_SIZE;
+      ++counts.evicted_clean;
     }
+    resident_bytes -= chunk.memory_bytes();
+    chunks.erase(pos);
+  }
+
+  void collect_spilled(std::vector<SavedChunk> &out) const {
+    for (const auto &[pos, bytes] : spilled)
+      out.push_back({pos, bytes});
+  }
 
-    return {cx, cy};
+  void refresh_exposure(Coord pos, int y0, int y1) {
+    Chunk *chunk = chunks.find(pos);
+    if (!chunk)
+      return;
+    chunk->refresh_exposure(y0, y1, chunks.find({pos.x - 1, pos.y}),
+                            chunks.find({pos.x + 1, pos.y}),
+                            chunks.find({pos.x, pos.y - 1}),
+                            chunks.find({pos.x, pos.y + 1}));
   }
+
+  // A new chunk can expose ores along its own border and along the borders
+  // of the chunks next to it, which were computed with it missing.
+  void link_exposure(Chunk &chunk) {
+    Coord pos = chunk.get_position();
+    refresh_exposure(pos, 0, CHUNK_SIZE - 1);
+    refresh_exposure({pos.x - 1, pos.y}, 0, CHUNK_SIZE - 1);
+    refresh_exposure({pos.x + 1, pos.y}, 0, CHUNK_SIZE - 1);
+    refresh_exposure({pos.x, pos.y - 1}, CHUNK_SIZE - 1, CHUNK_SIZE - 1);
+    refresh_exposure({pos.x, pos.y + 1}, 0, 0);
+  }
+
 };
 
 inline void print_world(World &world, int min_x, int max_x, int min_y,
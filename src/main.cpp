@@ -1,22 +1,36 @@
 #include "Benchmark.h"
+#include "AStar.h"
+#include "Autosave.h"
+#include "BlockAccessor.h"
 #include "BlockType.h"
 #include "Chunk.h"
 #include "Coord.h"
 #include "FastRand.h"
+#include "FlowField.h"
+#include "FrameClock.h"
 #include "GameWindow.h"
 #include "Input.h"
+#include "MobBenchmark.h"
+#include "MobStorage.h"
+#include "PackedBlocks.h"
+#include "PathCache.h"
+#include "RegionFile.h"
 #include "InventoryWindow.h"
 #include "Pixel.h"
 #include "ScreenBuffer.h"
 #include "World.h"
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <filesystem>
 #include <iostream>
 #include <stack>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 // THIS enables colored output on Windows terminal
 #ifdef _WIN32
@@ -200,11 +214,25 @@ void test_chunk() {
   cout << "\nChunk (1,0):\n";
   print_chunk(chunk2);
 
-  // 3. Bedrock is ALWAYS at bottom row (regardless of noise)
+  // 3. Bedrock floor at DEFAULT_BEDROCK_Y (regardless of noise), solid
+  //    below it; sky chunks are all AIR. Both are stored as a sentinel.
+  Chunk floor({0, DEFAULT_BEDROCK_Y >> CHUNK_SHIFT});
   for (int x = 0; x < CHUNK_SIZE; x++) {
-    assert(chunk.get_block(x, CHUNK_SIZE - 1) == BlockType::BEDROCK);
+    assert(floor.get_block(x, DEFAULT_BEDROCK_Y & CHUNK_MASK) ==
+           BlockType::BEDROCK);
   }
-  cout << "Bedrock layer: always at row " << CHUNK_SIZE - 1 << " - correct\n";
+  Chunk below({3, (DEFAULT_BEDROCK_Y >> CHUNK_SHIFT) + 1});
+  Chunk sky({-3, -2});
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      assert(below.get_block(x, y) == BlockType::BEDROCK);
+      assert(sky.get_block(x, y) == BlockType::AIR);
+    }
+  }
+  assert(below.memory_bytes() == sizeof(Chunk));
+  assert(sky.memory_bytes() == sizeof(Chunk));
+  cout << "Bedrock floor at y " << DEFAULT_BEDROCK_Y
+       << ", sky and bedrock chunks uniform - correct\n";
 
   // 4. Top rows should be AIR
   for (int x = 0; x < CHUNK_SIZE; x++) {
@@ -230,6 +258,50 @@ void test_chunk() {
   assert(chunk.get_block(5, 7) == BlockType::AIR);
   cout << "Mining: correct\n";
 
+  // 7. Chunks start packed; an edit unpacks, pack() folds a clean one back
+  Chunk packed_chunk({3, 0});
+  assert(packed_chunk.is_packed());
+  assert(packed_chunk.memory_bytes() < sizeof(ChunkBlocks));
+  packed_chunk.set_block(4, 4, BlockType::DIAMOND);
+  assert(!packed_chunk.is_packed() and !packed_chunk.pack());
+  packed_chunk.clear_dirty();
+  assert(packed_chunk.pack() and packed_chunk.is_packed());
+  assert(packed_chunk.get_block(4, 4) == BlockType::DIAMOND);
+  Chunk fresh_chunk({3, 0});
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      if (x != 4 or y != 4)
+        assert(packed_chunk.get_block(x, y) == fresh_chunk.get_block(x, y));
+    }
+  }
+  cout << "Packed chunk: " << packed_chunk.memory_bytes()
+       << " bytes, edit and repack - correct\n";
+
+  // 8. Encoding round-trips every palette width; damage is caught
+  for (int types : {1, 2, 3, 5, 10}) {
+    ChunkBlocks blocks;
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        int t = y < 10 ? 0 : static_cast<int>(fast_rand() % types);
+        blocks[y][x] = static_cast<BlockType>(t);
+      }
+    }
+    vector<uint8_t> bytes;
+    PackedBlocks::encode(blocks, bytes);
+    assert(PackedBlocks::valid(bytes));
+    PackedBlocks decoded;
+    decoded.assign(bytes);
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        assert(decoded.get(x, y) == blocks[y][x]);
+      }
+    }
+    assert(!PackedBlocks::valid({bytes.data(), bytes.size() - 1}));
+    bytes[0] = 0;
+    assert(!PackedBlocks::valid(bytes));
+  }
+  cout << "Palette encoding: round trip with 1 to 10 types - correct\n";
+
   cout << "All Chunk tests PASSED!\n";
 }
 
@@ -276,6 +348,29 @@ void test_terrain() {
   assert(smooth);
   cout << "Noise smoothness: correct\n";
 
+  // 5. Batched generator matches the per-cell generator exactly
+  std::array<std::array<BlockType, CHUNK_SIZE>, CHUNK_SIZE> ref, fast;
+  for (int cy = -2; cy <= 4; cy++) {
+    for (int cx = -50; cx < 50; cx++) {
+      generate_chunk_terrain_reference(ref, cx, cy);
+      generate_chunk_terrain(fast, cx, cy);
+      assert(ref == fast);
+    }
+  }
+  // A shallower floor, mid-chunk
+  for (int cx = -5; cx < 5; cx++) {
+    generate_chunk_terrain_reference(ref, cx, 1, TERRAIN_SEED, 45);
+    generate_chunk_terrain(fast, cx, 1, TERRAIN_SEED, 45);
+    assert(ref == fast);
+    assert(ref[45 - CHUNK_SIZE][7] == BlockType::BEDROCK);
+  }
+  float batch[CHUNK_SIZE];
+  fbm_batch(-7, CHUNK_SIZE, 42, batch);
+  for (int i = 0; i < CHUNK_SIZE; i++) {
+    assert(batch[i] == fbm(static_cast<float>(-7 + i), 42));
+  }
+  cout << "Batched noise: identical to scalar\n";
+
   cout << "All Terrain tests PASSED!\n";
 }
 
@@ -318,9 +413,1067 @@ void test_world() {
   cout << "\nWorld view (x: 0-29, y: 0-9):\n";
   print_world(world, 0, 29, 0, 9);
 
+  // 8. Background generation: peek never blocks, get_block waits for the
+  // worker, and the result matches synchronous generation
+  World async_world;
+  BlockType peeked;
+  assert(!async_world.peek_block(1000, 7, peeked));
+  async_world.prefetch_around(1000, 7, 1, 2);
+  assert(async_world.get_block(1000, 7) == world.get_block(1000, 7));
+  async_world.begin_frame();
+  assert(async_world.frames_waited_on_generation() == 1);
+  for (int i = 0; i < 1000 and async_world.chunk_count() < 21; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    async_world.begin_frame();
+  }
+  assert(async_world.chunk_count() == 21); // 7 columns x 3 rows
+  assert(async_world.peek_block(1000 + 3 * CHUNK_SIZE, 7, peeked));
+  assert(async_world.frames_waited_on_generation() == 1);
+  cout << "Background generation: " << async_world.chunks_prefetched()
+       << " chunks prefetched, 1 frame waited - correct\n";
+
+  // 9. BlockAccessor and ChunkView agree with World::get_block
+  BlockAccessor blocks(world);
+  ChunkView view = blocks.view({-2, 0});
+  assert(view.origin_x() == -2 * CHUNK_SIZE);
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    BlockType row[CHUNK_SIZE];
+    view.read_row(y, row);
+    for (int x = -80; x < 40; x++) {
+      assert(blocks.get_block(x, y) == world.get_block(x, y));
+      if (x >= -64 and x < -32)
+        assert(row[x + 64] == world.get_block(x, y));
+    }
+  }
+  cout << "BlockAccessor/ChunkView: match World::get_block - correct\n";
+
+  // 10. copy_region spans chunk borders (negative ones too); padded variant
+  // adds the 1-cell border
+  const int rw = 70, rh = 40, rx = -40, ry = -5;
+  std::vector<BlockType> region(rw * rh);
+  std::vector<BlockType> padded((rw + 2) * (rh + 2));
+  world.copy_region(rx, ry, rw, rh, region.data());
+  world.copy_region_padded(rx, ry, rw, rh, padded.data());
+  for (int y = -1; y <= rh; y++) {
+    for (int x = -1; x <= rw; x++) {
+      BlockType expected = world.get_block(rx + x, ry + y);
+      if (x >= 0 and x < rw and y >= 0 and y < rh)
+        assert(region[y * rw + x] == expected);
+      assert(padded[(y + 1) * (rw + 2) + (x + 1)] == expected);
+    }
+  }
+  cout << "copy_region: " << rw << "x" << rh
+       << " across 3x3 chunks matches get_block - correct\n";
+
+  // 11. Exposure masks match the brute-force ore rule, also after edits on
+  // and across chunk borders
+  auto check_exposure = [&world](int x0, int x1, int y0, int y1) {
+    for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+        bool expected = is_ore(world.get_block(x, y)) and
+                        (world.get_block(x - 1, y) == BlockType::AIR or
+                         world.get_block(x + 1, y) == BlockType::AIR or
+                         world.get_block(x, y - 1) == BlockType::AIR or
+                         world.get_block(x, y + 1) == BlockType::AIR);
+        assert(world.is_exposed(x, y) == expected);
+      }
+    }
+  };
+  check_exposure(-40, 29, 0, CHUNK_SIZE - 1);
+  for (int i = 0; i < 2000; i++) {
+    int x = -40 + static_cast<int>(fast_rand() % 70);
+    int y = static_cast<int>(fast_rand() % CHUNK_SIZE);
+    BlockType ore = static_cast<BlockType>(4 + i % 3); // IRON..DIAMOND
+    world.set_block(x, y, (i & 1) ? BlockType::AIR : ore);
+  }
+  world.set_block(-1, 20, BlockType::AIR); // west edge of chunk (0, 0)
+  world.set_block(31, 20, BlockType::AIR); // east edge of chunk (0, 0)
+  check_exposure(-39, 28, 1, CHUNK_SIZE - 2);
+  cout << "Ore exposure masks: match neighbour rule after 2000 edits - "
+          "correct\n";
+
+  // 12. Chunk rows are generated by depth, down to a configurable floor
+  World deep;
+  assert(deep.set_bedrock_y(100));
+  int differ = 0;
+  for (int x = 0; x < CHUNK_SIZE; x++) {
+    assert(deep.get_block(x, -200) == BlockType::AIR);
+    assert(deep.get_block(x, 100) == BlockType::BEDROCK);
+    assert(deep.get_block(x, 1000) == BlockType::BEDROCK);
+    assert(deep.get_block(x, 99) != BlockType::BEDROCK);
+    for (int y = CHUNK_SIZE; y < 2 * CHUNK_SIZE; y++)
+      differ += deep.get_block(x, y) != deep.get_block(x, y + CHUNK_SIZE);
+  }
+  assert(differ > CHUNK_SIZE);
+  // The floor stays where mob rows (16-bit) can reach it, below the dirt
+  assert(!deep.set_bedrock_y(32768) and !deep.set_bedrock_y(MAX_SURFACE_Y));
+  assert(deep.get_bedrock_y() == 100);
+  World lowest;
+  assert(lowest.set_bedrock_y(32767));
+  cout << "Vertical chunks: sky, distinct cave layers, floor at y 100 - "
+          "correct\n";
+
   cout << "All World tests PASSED!\n";
 }
 
+void test_change_tracking() {
+  cout << "\n=== CHANGE TRACKING TESTS ===\n";
+
+  World world;
+  BlockType before = world.get_block(5, 7);
+  Chunk &chunk = world.get_chunk({0, 0});
+  uint32_t mods = chunk.modification_count();
+  assert(!chunk.is_dirty());
+
+  // 1. An edit marks its cell and row dirty and bumps the counter; writing
+  //    the same block again is not an edit
+  BlockType after = before == BlockType::AIR ? BlockType::STONE
+                                             : BlockType::AIR;
+  world.set_block(5, 7, after);
+  world.set_block(5, 7, after);
+  assert(chunk.modification_count() == mods + 1);
+  assert(chunk.dirty_row_mask() == 1u << 7);
+  assert(chunk.dirty_row(7) == 1u << 5);
+  chunk.clear_dirty();
+  assert(!chunk.is_dirty() and chunk.modification_count() == mods + 1);
+  cout << "Chunk dirty bitmap and modification counter: correct\n";
+
+  // 2. The journal logs (x, y, old, new) in order; readers keep their own
+  //    cursors
+  world.set_block(-3, 40, BlockType::AIR);
+  uint64_t mark = world.changes().end();
+  world.set_block(-3, 40, BlockType::DIRT);
+  world.set_block(-3, 40, BlockType::AIR);
+  assert(world.changes().end() == mark + 2);
+
+  vector<BlockChange> seen;
+  assert(world.changes().read(mark, [&](const BlockChange &c) {
+    seen.push_back(c);
+  }));
+  assert(mark == world.changes().end() and seen.size() == 2);
+  assert(seen[0].x == -3 and seen[0].y == 40);
+  assert(seen[0].old_type == BlockType::AIR);
+  assert(seen[0].new_type == BlockType::DIRT);
+  assert(seen[1].old_type == BlockType::DIRT);
+  assert(seen[1].new_type == BlockType::AIR);
+
+  uint64_t from_start = world.changes().begin();
+  size_t replayed = 0;
+  assert(world.changes().read(from_start, [&](const BlockChange &c) {
+    assert(replayed > 0 or (c.old_type == before and c.new_type == after));
+    ++replayed;
+  }));
+  assert(replayed == world.changes().end());
+  cout << "Change journal: edits in order, independent readers - correct\n";
+
+  // 3. A reader left behind a trim is told to rescan
+  uint64_t stale = world.changes().begin();
+  world.trim_changes(world.changes().end());
+  assert(!world.changes().read(stale, [](const BlockChange &) {}));
+  uint64_t fresh = world.changes().end();
+  assert(world.changes().read(fresh, [](const BlockChange &) {}));
+  cout << "Trimmed journal: stale reader must rescan - correct\n";
+
+  cout << "All change tracking tests PASSED!\n";
+}
+
+void test_region_file() {
+  cout << "\n=== REGION FILE TESTS ===\n";
+
+  filesystem::path dir = filesystem::temp_directory_path() / "region_test";
+  filesystem::remove_all(dir);
+
+  // 1. Only edited chunks are written; a fresh world loads them back
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    world.get_block(100, 5); // generated, never edited
+    world.set_block(3, 4, BlockType::WOOD);
+    world.set_block(-40, 70, BlockType::GOLD); // another region
+    assert(world.save_dirty_chunks());
+    assert(store.stats().chunks_written == 2);
+    assert(store.stats().regions_written == 2);
+    assert(!world.get_chunk({0, 0}).is_dirty());
+    assert(world.save_dirty_chunks()); // nothing left to write
+    assert(store.stats().chunks_written == 2);
+  }
+  {
+    RegionStore store(dir);
+    assert(!store.find({0, 0}).empty());
+    assert(store.find({3, 0}).empty());
+    World world;
+    world.set_region_store(&store);
+    assert(world.get_block(3, 4) == BlockType::WOOD);
+    assert(world.get_block(-40, 70) == BlockType::GOLD);
+    assert(store.stats().chunks_loaded == 3);
+    cout << "Edited chunks saved and loaded back, untouched ones skipped\n";
+
+    // 2. Saving one chunk keeps the others already in its region
+    world.set_block(40, 4, BlockType::LEAF);
+    assert(world.save_dirty_chunks());
+  }
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    assert(world.get_block(3, 4) == BlockType::WOOD);
+    assert(world.get_block(40, 4) == BlockType::LEAF);
+    cout << "Rewriting a region keeps its other chunks\n";
+  }
+
+  // 3. A damaged region file reads as empty instead of as garbage
+  {
+    filesystem::path region = dir / "r.0.0.bin";
+    filesystem::resize_file(region, 100);
+    RegionStore store(dir);
+    assert(store.find({0, 0}).empty());
+    cout << "Truncated region file ignored\n";
+  }
+
+  filesystem::remove_all(dir);
+  cout << "All region file tests PASSED!\n";
+}
+
+void test_chunk_eviction() {
+  cout << "\n=== CHUNK EVICTION TESTS ===\n";
+
+  const size_t BUDGET = 64 * 1024;
+  auto explore = [&](World &world, int from, int to) {
+    int step = from < to ? 1 : -1;
+    for (int cx = from; cx != to + step; cx += step) {
+      world.begin_frame();
+      world.get_block(cx * CHUNK_SIZE, 5);
+      world.evict_to_budget(cx * CHUNK_SIZE, 5);
+      assert(world.residency().resident_bytes <= BUDGET);
+    }
+  };
+
+  // 1. Exploring stays under budget; edits survive in the spill
+  {
+    World world;
+    world.set_memory_budget(BUDGET);
+    world.set_block(3, 4, BlockType::AIR);
+    world.set_block(3, 4, BlockType::GOLD);
+    BlockType far = world.get_block(10 * CHUNK_SIZE + 7, 20);
+    explore(world, 0, 400);
+    ResidencyStats stats = world.residency();
+    assert(!world.find_chunk({0, 0}));
+    assert(stats.evicted_clean > 250);
+    assert(stats.evicted_edited == 1 and stats.spilled_chunks == 1);
+    assert(world.chunk_count() < 150);
+    cout << "400 chunks explored, " << stats.resident_chunks
+         << " resident (" << stats.resident_bytes << " bytes)\n";
+
+    // The running byte total matches a walk over the chunks
+    auto walked = [&] {
+      size_t bytes = 0;
+      for (int cx = -1; cx <= 401; cx++) {
+        if (const Chunk *chunk = world.find_chunk({cx, 0}))
+          bytes += chunk->memory_bytes();
+      }
+      return bytes;
+    };
+    assert(world.chunk_memory_bytes() == walked());
+    world.get_chunk({400, 0}).unpack();
+    assert(world.chunk_memory_bytes() == walked());
+    world.get_chunk({400, 0}).pack();
+    assert(world.chunk_memory_bytes() == walked());
+
+    explore(world, 400, 0);
+    assert(world.get_block(3, 4) == BlockType::GOLD);
+    assert(world.get_block(10 * CHUNK_SIZE + 7, 20) == far);
+    assert(world.residency().reloads >= 1);
+    assert(world.chunk_memory_bytes() == walked());
+    cout << "Dropped chunk regenerated, edited chunk reloaded from spill\n";
+  }
+
+  // 2. Chunks near the player and chunks used this frame are kept
+  {
+    World world;
+    world.set_memory_budget(1);
+    world.begin_frame();
+    world.get_block(0, 5);
+    world.get_block(20 * CHUNK_SIZE, 5);
+    world.begin_frame();
+    world.get_block(-20 * CHUNK_SIZE, 5);
+    world.evict_to_budget(0, 5);
+    assert(world.find_chunk({0, 0}));
+    assert(!world.find_chunk({20, 0}));
+    assert(world.find_chunk({-20, 0}));
+    cout << "Nearby and in-use chunks kept\n";
+  }
+
+  // 3. With a region store, evicted edits are written to it
+  filesystem::path dir = filesystem::temp_directory_path() / "evict_test";
+  filesystem::remove_all(dir);
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    world.set_memory_budget(BUDGET);
+    world.set_block(3, 4, BlockType::AIR);
+    world.set_block(3, 4, BlockType::LEAF);
+    explore(world, 0, 200);
+    assert(world.residency().spilled_chunks == 0);
+    assert(store.stats().chunks_written == 1);
+  }
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    assert(world.get_block(3, 4) == BlockType::LEAF);
+    cout << "Evicted edits spilled to the region store\n";
+  }
+
+  // 4. Editing a chunk reloaded from the spill retires the spilled copy
+  filesystem::remove_all(dir);
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_memory_budget(1);
+    auto evict_origin = [&] {
+      world.begin_frame();
+      world.evict_to_budget(100 * CHUNK_SIZE, 5);
+      assert(!world.find_chunk({0, 0}));
+    };
+    world.set_block(3, 4, BlockType::AIR);
+    world.set_block(3, 4, BlockType::WOOD);
+    evict_origin(); // spilled, no store to take it yet
+    world.set_region_store(&store);
+    world.set_block(3, 4, BlockType::GOLD);
+    assert(world.save_dirty_chunks());
+    evict_origin(); // clean now, dropped
+    assert(world.residency().spilled_chunks == 0);
+    assert(world.get_block(3, 4) == BlockType::GOLD);
+  }
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    assert(world.get_block(3, 4) == BlockType::GOLD);
+    cout << "Reloaded and edited chunk saved over its spilled copy\n";
+  }
+  filesystem::remove_all(dir);
+
+  cout << "All chunk eviction tests PASSED!\n";
+}
+
+void test_autosave() {
+  cout << "\n=== AUTOSAVE TESTS ===\n";
+
+  filesystem::path dir = filesystem::temp_directory_path() / "autosave_test";
+  filesystem::remove_all(dir);
+  filesystem::path state_file = dir / "player.bin";
+  auto edit = [](World &world, int x, int y, BlockType type) {
+    world.set_block(x, y, BlockType::AIR);
+    world.set_block(x, y, type);
+  };
+
+  // 1. Chunks edited during the save stay dirty; the rest are saved
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    MobStorage mobs;
+    mobs.add(5, 6, 20, MobType::ZOMBIE, AIState::CHASING);
+    mobs.add(-300, 12, 7, MobType::ZOMBIE, AIState::IDLE);
+    PlayerState player;
+    player.x = 123;
+    player.y = -4;
+    player.facing = -1;
+    player.inventory[3] = 17;
+    player.selected_block = 3;
+
+    edit(world, 3, 4, BlockType::WOOD);
+    edit(world, 100, 4, BlockType::GOLD);
+    Autosaver saver(world, store, state_file);
+    assert(saver.start(player, mobs));
+    assert(!saver.start(player, mobs)); // one save at a time
+    uint64_t snapshot_end = world.changes().end();
+    edit(world, 100, 5, BlockType::LEAF); // after the snapshot
+    saver.wait();
+    assert(!saver.busy());
+    assert(saver.stats().saves == 1 and saver.stats().chunks_saved == 2);
+    assert(!world.get_chunk({0, 0}).is_dirty());
+    assert(world.get_chunk({0, 0}).is_packed());
+    assert(world.get_chunk({3, 0}).is_dirty());
+    assert(world.changes().begin() == snapshot_end); // saved edits trimmed
+    cout << "Snapshot saved in the background, later edits kept dirty\n";
+
+    assert(saver.save_now(player, mobs));
+    assert(!world.get_chunk({3, 0}).is_dirty());
+  }
+
+  // 2. A fresh world, player and mobs come back from the files
+  {
+    RegionStore store(dir);
+    World world;
+    world.set_region_store(&store);
+    assert(world.get_block(3, 4) == BlockType::WOOD);
+    assert(world.get_block(100, 4) == BlockType::GOLD);
+    assert(world.get_block(100, 5) == BlockType::LEAF);
+
+    PlayerState player;
+    std::vector<Mob> mobs;
+    assert(load_game_state(state_file, player, mobs));
+    assert(player.x == 123 and player.y == -4 and player.facing == -1);
+    assert(player.inventory[3] == 17 and player.selected_block == 3);
+    assert(mobs.size() == 2);
+    assert(mobs[1].x == -300 and mobs[1].y == 12 and mobs[1].hp == 7);
+    assert(mobs[1].state == AIState::IDLE);
+    assert(!filesystem::exists(dir / "player.bin.tmp"));
+    cout << "World, player and mobs loaded back\n";
+  }
+
+  // 3. A damaged state file is refused
+  {
+    filesystem::resize_file(state_file, 30);
+    PlayerState player;
+    player.x = 9;
+    std::vector<Mob> mobs;
+    assert(!load_game_state(state_file, player, mobs));
+    assert(player.x == 9);
+    assert(!load_game_state(dir / "missing.bin", player, mobs));
+    cout << "Truncated state file ignored\n";
+  }
+
+  filesystem::remove_all(dir);
+  cout << "All autosave tests PASSED!\n";
+}
+
+void test_screen_diff() {
+  cout << "\n=== SCREEN DIFF TESTS ===\n";
+
+  ScreenBuffer screen;
+  std::string out;
+
+  // 1. First frame is always a full redraw
+  screen.clear();
+  screen.draw_text(0, 0, "HELLO", Color::GREEN);
+  screen.compose_frame(out);
+  assert(out.rfind("\033[H", 0) == 0);
+  assert(screen.total_full_redraws() == 1);
+
+  // 2. Unchanged frame emits nothing
+  screen.compose_frame(out);
+  assert(out.empty());
+
+  // 3. One changed cell: a cursor move, its color and its character
+  screen.set_pixel(10, 5, {'@', Color::CYAN});
+  screen.compose_frame(out);
+  assert(out == "\033[6;11H\033[36m@\033[m");
+  assert(screen.total_full_redraws() == 1);
+
+  // 4. Above the damage ratio it falls back to a full redraw
+  screen.set_full_redraw_ratio(0.25f);
+  for (int y = 0; y < SCREEN_HEIGHT / 2; y++) {
+    screen.draw_text(0, y, std::string(SCREEN_WIDTH, '#'), Color::GRAY);
+  }
+  screen.compose_frame(out);
+  assert(out.rfind("\033[H", 0) == 0);
+  assert(screen.total_full_redraws() == 2);
+
+  // 5. invalidate() forces the next frame to be full
+  screen.invalidate();
+  screen.compose_frame(out);
+  assert(screen.total_full_redraws() == 3);
+
+  // 6. resize() clears the terminal and redraws at the new size, \r\n
+  // between rows and none after the last
+  screen.resize(120, 3);
+  assert(screen.get_width() == 120 and screen.get_height() == 3);
+  screen.clear();
+  screen.set_pixel(119, 2, {'@', Color::WHITE});
+  assert(screen.get_pixel(119, 2).ch == '@');
+  screen.compose_frame(out);
+  assert(out.rfind("\033[2J\033[H", 0) == 0);
+  assert(out.size() == 7 + 120 * 3 + 2 * 2 + 3);
+  screen.set_pixel(0, 0, {'x', Color::WHITE});
+  screen.compose_frame(out);
+  assert(out == "\033[1;1Hx\033[m");
+  cout << "Diff output: " << screen.total_bytes_written() << " bytes over "
+       << screen.total_frames() << " frames\n";
+
+  cout << "All Screen diff tests PASSED!\n";
+}
+
+void test_input() {
+  cout << "\n=== INPUT TESTS ===\n";
+
+  auto parse = [](const char *text, InputState &state) {
+    string bytes(text);
+    return parse_input(reinterpret_cast<const unsigned char *>(bytes.data()),
+                       bytes.size(), state);
+  };
+
+  // 1. Plain keys
+  InputState state;
+  assert(parse("aW3q", state) == 4);
+  assert(state.move_left and state.jump and state.quit);
+  assert(state.select_block == 3 and !state.move_right);
+
+  // 2. ANSI arrows (CSI and SS3 forms), mixed with keys, in one read
+  state = InputState{};
+  assert(parse("\033[Dd\033[C\033OA\033[B\r", state) == 14);
+  assert(state.mine_left and state.mine_right and state.mine_up);
+  assert(state.mine_down and state.move_right and state.confirm_inventory);
+
+  // 3. A sequence cut off by the end of a read is left for the next one
+  state = InputState{};
+  assert(parse("d\033[", state) == 1);
+  assert(state.move_right and !state.mine_left);
+  state = InputState{};
+  assert(parse("d\033", state) == 1);
+
+  // 4. A lone ESC is ignored
+  state = InputState{};
+  assert(parse("\033e", state) == 2);
+  assert(state.open_inventory);
+
+  // 5. Arrows with modifiers; other CSI sequences leave no keys behind
+  state = InputState{};
+  assert(parse("\033[1;5D\033[1;2A", state) == 12);
+  assert(state.mine_left and state.mine_up);
+  assert(!state.move_left and !state.move_right and state.select_block == 0);
+  state = InputState{};
+  assert(parse("\033[1~\033[5~\033[4~\033[15~\033[2;3~", state) == 23);
+  assert(state.select_block == 0 and !state.move_right);
+  assert(!state.mine_left and !state.mine_up);
+  state = InputState{};
+  assert(parse("\033[5;5D\033[1;5", state) == 6);
+  assert(!state.mine_left and state.select_block == 0);
+
+  cout << "All Input tests PASSED!\n";
+}
+
+void test_frame_clock() {
+  cout << "\n=== FRAME CLOCK TESTS ===\n";
+
+  // 1. Leftover time carries over between frames
+  FixedTimestep sim(0.01, 5);
+  assert(sim.advance(0.025) == 2);
+  assert(sim.advance(0.006) == 1);
+  assert(std::abs(sim.alpha() - 0.1) < 1e-6);
+
+  // 2. A stall runs at most the catch-up cap and drops the rest
+  assert(sim.advance(0.1) == 5);
+  assert(sim.steps_dropped() == 5);
+  assert(sim.advance(0.0) == 0 and sim.alpha() == 0.0);
+
+  // 3. Percentiles by nearest rank
+  FrameStats stats;
+  for (int i = 1; i <= 100; i++) {
+    stats.record(i);
+  }
+  assert(stats.count() == 100);
+  assert(stats.percentile(0) == 1 and stats.percentile(100) == 100);
+  assert(stats.percentile(50) == 51 and stats.percentile(95) == 95);
+
+  // 4. precise_sleep_until doesn't wake early
+  auto deadline = FrameClock::now() + std::chrono::milliseconds(3);
+  precise_sleep_until(deadline);
+  assert(FrameClock::now() >= deadline);
+
+  cout << "All FrameClock tests PASSED!\n";
+}
+
+void test_flow_field() {
+  cout << "\n=== FLOW FIELD TESTS ===\n";
+
+  World world;
+  Coord player = {5, 0};
+  while (world.get_block(player.x, player.y + 1) == BlockType::AIR) {
+    player.y++;
+  }
+  // Dig a pit so some cells need climbing out of
+  for (int y = player.y + 1; y < player.y + 5; y++) {
+    world.set_block(player.x + 8, y, BlockType::AIR);
+  }
+
+  FlowField field;
+  field.build(world, player, 60, CHUNK_SIZE, 30);
+  assert(field.distance(player) == 0);
+
+  // 1. Distances match per-mob BFS, and every step is a legal move that
+  // gets one closer
+  auto block = [&](int x, int y) { return world.get_block(x, y); };
+  int reachable = 0;
+  for (int x = player.x - 40; x <= player.x + 40; x += 3) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      Coord mob = {x, y};
+      if (world.get_block(x, y) != BlockType::AIR or mob == player) {
+        continue;
+      }
+      vector<Coord> path = bfs_findpath(mob, player, world, 30);
+      int d = field.distance(mob);
+      assert(d == static_cast<int>(path.size()) - 1);
+
+      Coord next;
+      if (d > 0) {
+        reachable++;
+        assert(field.next_step(mob, next));
+        assert(can_step(block, mob, next - mob));
+        assert(field.distance(next) == d - 1);
+      } else {
+        assert(!field.next_step(mob, next));
+      }
+    }
+  }
+  cout << "Cells with a path to the player: " << reachable << "\n";
+  assert(reachable > 0);
+
+  // 2. Outside the box nothing is known
+  assert(field.distance({player.x + 61, player.y}) == -1);
+
+  // 3. PathContext returns exactly what bfs_findpath does, query after
+  // query, including when the depth grows past its initial size
+  PathContext context(10);
+  int found = 0;
+  for (int x = player.x - 30; x <= player.x + 30; x += 2) {
+    for (int y = 0; y < CHUNK_SIZE; y += 2) {
+      for (int depth : {10, 30, 50}) {
+        vector<Coord> expected = bfs_findpath({x, y}, player, world, depth);
+        const vector<Coord> &got =
+            context.find_path({x, y}, player, world, depth);
+        assert(got.size() == expected.size());
+        for (size_t i = 0; i < got.size(); i++) {
+          assert(got[i] == expected[i]);
+        }
+        found += !got.empty();
+      }
+    }
+  }
+  cout << "PathContext agrees with bfs_findpath (" << found
+       << " paths found)\n";
+
+  cout << "All FlowField tests PASSED!\n";
+}
+
+void test_astar() {
+  cout << "\n=== A* TESTS ===\n";
+
+  // 1. The heuristic is the exact move count with nothing in the way
+  assert(gravity_heuristic({0, 0}, {5, 0}) == 5);
+  assert(gravity_heuristic({0, 0}, {3, 4}) == 7);  // walk, then fall
+  assert(gravity_heuristic({0, 0}, {3, -5}) == 5); // climb diagonally
+  assert(gravity_heuristic({0, 0}, {-6, -2}) == 6);
+
+  // 2. A* finds paths exactly as short as BFS, expanding fewer nodes; with
+  // jump points every path found is still made of legal moves
+  World world;
+  auto block = [&](int x, int y) { return world.get_block(x, y); };
+  PathContext bfs(60);
+  AStarPathfinder astar(60);
+  AStarPathfinder jps(60);
+  jps.set_jump_points(true);
+
+  int found = 0, jps_found = 0;
+  for (int x = -60; x <= 60; x += 7) {
+    for (int y = 0; y < CHUNK_SIZE; y += 3) {
+      Coord from = {x, y};
+      Coord to = {x / 2 + 11, 9};
+      if (world.get_block(x, y) != BlockType::AIR) {
+        continue;
+      }
+      size_t expected = bfs.find_path(from, to, world, 60).size();
+      const vector<Coord> &path = astar.find_path(from, to, world, 60);
+      assert(path.size() == expected);
+      for (size_t i = 1; i < path.size(); i++) {
+        assert(can_step(block, path[i - 1], path[i] - path[i - 1]));
+      }
+      found += expected > 0;
+
+      const vector<Coord> &jump_path = jps.find_path(from, to, world, 60);
+      if (!jump_path.empty()) {
+        jps_found++;
+        assert(jump_path.front() == from and jump_path.back() == to);
+        for (size_t i = 1; i < jump_path.size(); i++) {
+          assert(can_step(block, jump_path[i - 1],
+                          jump_path[i] - jump_path[i - 1]));
+        }
+      }
+    }
+  }
+  cout << "Paths: " << found << " (jump points: " << jps_found
+       << "), nodes expanded BFS " << bfs.nodes_expanded() << ", A* "
+       << astar.stats().nodes_expanded << ", A* + jumps "
+       << jps.stats().nodes_expanded << "\n";
+  assert(found > 0);
+  assert(astar.stats().nodes_expanded < bfs.nodes_expanded());
+
+  cout << "All A* tests PASSED!\n";
+}
+
+void test_path_cache() {
+  cout << "\n=== PATH CACHE TESTS ===\n";
+
+  World world;
+  // A flat stone floor at y = 20 with open air above
+  for (int x = -20; x <= 20; x++) {
+    for (int y = 10; y < 20; y++) {
+      world.set_block(x, y, BlockType::AIR);
+    }
+    world.set_block(x, 20, BlockType::STONE);
+  }
+
+  MobStorage mobs;
+  world.add_block_listener(&mobs.paths);
+  mobs.add(-10, 19, 20, MobType::ZOMBIE, AIState::CHASING);
+  mobs.add(10, 19, 20, MobType::ZOMBIE, AIState::CHASING);
+
+  Coord player = {0, 19};
+  PathContext bfs(30);
+  Coord next;
+
+  // 1. Planned once, then followed from the cache step by step
+  assert(!mobs.paths.next_step(0, mobs.get_pos(0), player, next));
+  vector<Coord> plan = bfs.find_path(mobs.get_pos(0), player, world, 30);
+  assert(mobs.paths.store(0, plan, player, next));
+  assert(next == plan[1]);
+  mobs.set_pos(0, next);
+  for (size_t s = 2; s < 6; s++) {
+    assert(mobs.paths.next_step(0, mobs.get_pos(0), player, next));
+    assert(next == plan[s]);
+    mobs.set_pos(0, next);
+  }
+  assert(mobs.paths.stats().hits == 4 and mobs.paths.stats().replans == 1);
+  assert(mobs.paths.remaining(0) == plan.size() - 6);
+
+  // 2. The player wandering a little keeps the path, further drops it
+  assert(mobs.paths.next_step(0, mobs.get_pos(0), {2, 19}, next));
+  mobs.set_pos(0, next);
+  assert(!mobs.paths.next_step(0, mobs.get_pos(0), {5, 19}, next));
+  assert(mobs.paths.stats().player_moved == 1);
+
+  // 3. Mining next to a path drops it at once; edits elsewhere don't
+  plan = bfs.find_path(mobs.get_pos(1), player, world, 30);
+  assert(mobs.paths.store(1, plan, player, next));
+  mobs.set_pos(1, next);
+  world.set_block(-15, 20, BlockType::AIR);
+  assert(mobs.paths.has_path(1));
+  world.set_block(5, 20, BlockType::AIR);
+  assert(!mobs.paths.has_path(1));
+  assert(mobs.paths.stats().edited == 1);
+
+  // 4. A mob moved off its path (it fell, say) replans
+  plan = bfs.find_path(mobs.get_pos(1), player, world, 30);
+  assert(mobs.paths.store(1, plan, player, next));
+  assert(!mobs.paths.next_step(1, {next.x, next.y + 1}, player, next));
+
+  // 5. Removing a mob keeps the other's path with it
+  plan = bfs.find_path(mobs.get_pos(1), player, world, 30);
+  assert(mobs.paths.store(1, plan, player, next));
+  mobs.set_pos(1, next);
+  mobs.remove(0);
+  assert(mobs.paths.next_step(0, mobs.get_pos(0), player, next));
+  assert(next == plan[2]);
+
+  // 6. Paths stay intact through arena compaction
+  Coord start = mobs.get_pos(0);
+  for (int r = 0; r < 2000; r++) {
+    plan = bfs.find_path(start, player, world, 30);
+    assert(mobs.paths.store(0, plan, player, next));
+  }
+  assert(mobs.paths.arena_bytes() < 2000 * (plan.size() - 1));
+  mobs.set_pos(0, next);
+  assert(mobs.paths.next_step(0, mobs.get_pos(0), player, next));
+  assert(next == plan[2]);
+
+  world.remove_block_listener(&mobs.paths);
+  cout << "All PathCache tests PASSED!\n";
+}
+
+void test_mob_grid() {
+  cout << "\n=== MOB GRID TESTS ===\n";
+
+  // Random adds, moves and removes; every query must match a linear scan
+  MobStorage mobs;
+  seed_fast_rand(2024);
+  auto random_pos = [] {
+    return Coord{static_cast<int>(fast_rand() % 200) - 100,
+                 static_cast<int>(fast_rand() % 64) - 16};
+  };
+  for (int step = 0; step < 5000; step++) {
+    uint32_t op = fast_rand() % 10;
+    if (op < 4 or mobs.count() == 0) {
+      Coord p = random_pos();
+      mobs.add(p.x, p.y, 20, MobType::ZOMBIE, AIState::CHASING);
+    } else if (op < 8) {
+      size_t i = fast_rand() % mobs.count();
+      Coord p = mobs.get_pos(i);
+      mobs.set_pos(i, {p.x + static_cast<int>(fast_rand() % 41) - 20,
+                       p.y + static_cast<int>(fast_rand() % 5) - 2});
+    } else {
+      mobs.remove(fast_rand() % mobs.count());
+    }
+
+    if (step % 50 == 0) {
+      Coord c = random_pos();
+      vector<size_t> found;
+      mobs.grid.query(c.x - 40, c.y - 12, c.x + 39, c.y + 11,
+                      [&](size_t i) { found.push_back(i); });
+      size_t in_rect = 0;
+      for (size_t i = 0; i < mobs.count(); i++) {
+        if (abs(mobs.x[i] - c.x + 0.5) < 40 and
+            abs(mobs.y[i] - c.y + 0.5) < 12) {
+          in_rect++;
+          assert(std::find(found.begin(), found.end(), i) != found.end());
+        }
+      }
+      assert(found.size() == in_rect);
+
+      size_t in_radius = 0, near = 0;
+      mobs.grid.query_radius(c, 30, [&](size_t) { in_radius++; });
+      for (size_t i = 0; i < mobs.count(); i++) {
+        int dx = mobs.x[i] - c.x;
+        int dy = mobs.y[i] - c.y;
+        near += dx * dx + dy * dy <= 900;
+      }
+      assert(in_radius == near);
+    }
+  }
+  assert(mobs.grid.size() == mobs.count());
+  cout << "Grid matches a linear scan over " << mobs.count() << " mobs\n";
+
+  cout << "All MobGrid tests PASSED!\n";
+}
+
+void test_mob_storage() {
+  cout << "\n=== MOB STORAGE TESTS ===\n";
+
+  // 1. Columns share one allocation, each on a 64-byte boundary, and keep
+  // their contents as it grows
+  MobStorage mobs;
+  vector<MobHandle> handles;
+  for (int i = 0; i < 1000; i++) {
+    handles.push_back(
+        mobs.add(i, i % 50, 20, MobType::ZOMBIE, AIState::CHASING));
+  }
+  auto aligned = [](const void *p) {
+    return reinterpret_cast<uintptr_t>(p) % 64 == 0;
+  };
+  assert(aligned(mobs.x) and aligned(mobs.y) and aligned(mobs.hp));
+  assert(aligned(mobs.type) and aligned(mobs.state) and aligned(mobs.tier));
+  for (int i = 0; i < 1000; i++) {
+    assert(mobs.x[i] == i and mobs.y[i] == i % 50 and mobs.hp[i] == 20);
+  }
+  cout << "Columns aligned and preserved across growth\n";
+
+  // 2. Handles follow their mob through swap-with-last removals
+  mobs.remove(mobs.index_of(handles[10]));
+  assert(!mobs.alive(handles[10]));
+  assert(mobs.index_of(handles[10]) == MobStorage::NO_MOB);
+  assert(mobs.index_of(handles[999]) == 10 and mobs.x[10] == 999);
+  for (int i = 0; i < 1000; i++) {
+    if (i != 10)
+      assert(mobs.x[mobs.index_of(handles[i])] == i);
+  }
+
+  // A reused id gets a new generation; the old handle stays dead
+  MobHandle reused = mobs.add(-5, 0, 20, MobType::ZOMBIE, AIState::CHASING);
+  assert(reused.id == handles[10].id and !(reused == handles[10]));
+  assert(!mobs.alive(handles[10]) and mobs.alive(reused));
+  assert(mobs.handle(mobs.index_of(reused)) == reused);
+  cout << "Handles survive removals, stale handles stay dead\n";
+
+  // 3. damage_in_radius matches a scalar check, cull_dead removes the dead
+  size_t expected = 0;
+  for (size_t i = 0; i < mobs.count(); i++) {
+    int dx = mobs.x[i] - 100;
+    int dy = mobs.y[i] - 10;
+    expected += dx * dx + dy * dy <= 400;
+  }
+  assert(mobs.damage_in_radius({100, 10}, 20, 15) == expected);
+  assert(mobs.hp[mobs.index_of(handles[100])] == 5);
+  assert(mobs.hp[mobs.index_of(handles[500])] == 20);
+  assert(mobs.damage_in_radius({100, 10}, 20, 15) == expected);
+  assert(mobs.hp[mobs.index_of(handles[100])] == 0);
+
+  size_t before = mobs.count();
+  assert(mobs.cull_dead() == expected);
+  assert(mobs.count() == before - expected);
+  assert(!mobs.alive(handles[100]) and mobs.alive(handles[500]));
+  for (size_t i = 0; i < mobs.count(); i++) {
+    assert(mobs.hp[i] > 0);
+    assert(mobs.index_of(mobs.handle(i)) == i);
+  }
+  assert(mobs.grid.size() == mobs.count());
+  assert(mobs.cull_dead() == 0);
+  cout << "Damaged " << expected << " mobs in radius and culled them\n";
+
+  // 4. y beyond 16 bits is clamped, in the column and in the grid alike
+  MobStorage edge;
+  edge.add(0, MobStorage::MAX_Y, 20, MobType::ZOMBIE, AIState::CHASING);
+  edge.add(1, MobStorage::MAX_Y + 1, 20, MobType::ZOMBIE, AIState::CHASING);
+  edge.add(2, -40000, 20, MobType::ZOMBIE, AIState::CHASING);
+  assert(edge.y[0] == 32767 and edge.y[1] == 32767 and edge.y[2] == -32768);
+  edge.set_pos(0, {0, 70000});
+  assert(edge.y[0] == 32767);
+  edge.set_pos(2, {2, -32768});
+  assert(edge.y[2] == -32768);
+  size_t found = 0;
+  edge.grid.query(0, 32767, 2, 32767, [&](size_t) { ++found; });
+  assert(found == 2);
+  found = 0;
+  edge.grid.query(0, -32768, 2, -32768, [&](size_t) { ++found; });
+  assert(found == 1);
+  cout << "Mob rows clamped to 16 bits, grid agrees\n";
+
+  cout << "All MobStorage tests PASSED!\n";
+}
+
+void test_sim_tiers() {
+  cout << "\n=== SIM TIER TESTS ===\n";
+
+  // 1. Distance bands: a box for the view, then a radius for MID
+  MobStorage bands;
+  bands.add(10, 5, 20, MobType::ZOMBIE, AIState::CHASING);
+  bands.add(-50, 0, 20, MobType::ZOMBIE, AIState::CHASING);
+  bands.add(0, 40, 20, MobType::ZOMBIE, AIState::CHASING);
+  bands.add(200, 0, 20, MobType::ZOMBIE, AIState::CHASING);
+  bands.assign_tiers({0, 0}, 44, 16, 96);
+  assert(bands.tier[0] == SimTier::VIEW);
+  assert(bands.tier[1] == SimTier::MID);
+  assert(bands.tier[2] == SimTier::MID);
+  assert(bands.tier[3] == SimTier::FAR);
+  assert(bands.mobs_in(SimTier::MID).size() == 2);
+  assert(bands.mobs_in(SimTier::FAR).size() == 1);
+  cout << "Mobs sorted into VIEW / MID / FAR bands\n";
+
+  // 2. In the game: MID mobs walk every other move, FAR mobs drop in batches
+  World world;
+  for (int x = -100; x <= 20; x++) {
+    for (int y = 10; y < 20; y++) {
+      world.set_block(x, y, BlockType::AIR);
+    }
+    world.set_block(x, 20, BlockType::STONE);
+  }
+  for (int y = 2; y < 21; y++) {
+    world.set_block(300, y, BlockType::AIR);
+  }
+  world.set_block(300, 21, BlockType::STONE);
+
+  int player_x = 0, player_y = 19, facing = 1, selected = 1;
+  int inventory[9] = {0};
+  GameWindow game(world, player_x, player_y, facing, inventory, selected);
+  MobStorage &mobs = game.get_mobs();
+  mobs.add(300, 2, 20, MobType::ZOMBIE, AIState::CHASING);
+  mobs.add(-80, 19, 20, MobType::ZOMBIE, AIState::CHASING);
+
+  for (int move = 0; move < 4; move++) {
+    game.update(0.5);
+  }
+  assert(mobs.tier[0] == SimTier::FAR and mobs.y[0] == 10);
+  assert(mobs.tier[1] == SimTier::MID and mobs.x[1] == -78);
+
+  for (int move = 4; move < 17; move++) {
+    game.update(0.5);
+  }
+  assert(mobs.y[0] == 20);
+  cout << "MID mob steered, FAR mob settled on the ground\n";
+
+  cout << "All SimTier tests PASSED!\n";
+}
+
+void test_parallel_ai() {
+  cout << "\n=== PARALLEL MOB AI TESTS ===\n";
+
+  // The same arena and mobs, moved with 0 (serial), 1, 2 and 4 AI threads,
+  // must end up in exactly the same places.
+  auto run = [](unsigned threads) {
+    seed_fast_rand(99);
+    World world;
+    for (int x = -100; x <= 20; x++) {
+      for (int y = 10; y < 20; y++) {
+        world.set_block(x, y, BlockType::AIR);
+      }
+      world.set_block(x, 20, BlockType::STONE);
+    }
+    // A wall to climb around and a step to climb, so some mobs need A*
+    for (int y = 15; y < 20; y++) {
+      world.set_block(-10, y, BlockType::STONE);
+    }
+    world.set_block(-40, 19, BlockType::STONE);
+    for (int y = 2; y < 21; y++) {
+      world.set_block(300, y, BlockType::AIR);
+    }
+
+    int player_x = 0, player_y = 19, facing = 1, selected = 1;
+    int inventory[9] = {0};
+    GameWindow game(world, player_x, player_y, facing, inventory, selected);
+    game.set_ai_threads(threads);
+    MobStorage &mobs = game.get_mobs();
+    for (int i = 0; i < 300; i++) {
+      mobs.add(-100 + static_cast<int>(fast_rand() % 121),
+               10 + static_cast<int>(fast_rand() % 10), 20, MobType::ZOMBIE,
+               AIState::CHASING);
+    }
+    mobs.add(300, 2, 20, MobType::ZOMBIE, AIState::CHASING);
+
+    for (int move = 0; move < 24; move++) {
+      game.update(0.5);
+    }
+    vector<Coord> positions;
+    for (size_t i = 0; i < mobs.count(); i++) {
+      positions.push_back(mobs.get_pos(i));
+    }
+    return positions;
+  };
+
+  vector<Coord> serial = run(0);
+  for (unsigned threads : {1u, 2u, 4u}) {
+    assert(run(threads) == serial);
+  }
+  cout << "Mob moves identical with 0, 1, 2 and 4 AI threads\n";
+
+  cout << "All parallel AI tests PASSED!\n";
+}
+
+void test_chunk_table() {
+  cout << "\n=== CHUNK TABLE TESTS ===\n";
+
+  // 1. Index table agrees with unordered_map through inserts and erases
+  const uint32_t NONE = 0xFFFFFFFFu;
+  FlatKeyTable<uint32_t, NONE> table;
+  unordered_map<Coord, uint32_t, CoordHash> reference;
+  for (uint32_t i = 0; i < 20000; i++) {
+    Coord c = {static_cast<int>(fast_rand() % 200) - 100,
+               static_cast<int>(fast_rand() % 7) - 3};
+    if (fast_rand() % 3 == 0) {
+      assert(table.erase(pack_coord(c)) == (reference.erase(c) == 1));
+    } else {
+      table.insert(pack_coord(c), i);
+      reference[c] = i;
+    }
+  }
+  assert(table.size() == reference.size());
+  for (auto &[c, v] : reference) {
+    assert(table.find(pack_coord(c)) == v);
+  }
+  assert(table.find(pack_coord({5000, 5000})) == NONE);
+  cout << "Index table: " << table.size()
+       << " live keys match unordered_map after 20000 ops - correct\n";
+
+  // 2. Packed keys round-trip, including negative coordinates
+  Coord neg = {-123, -4};
+  assert(unpack_coord(pack_coord(neg)) == neg);
+
+  // 3. Chunks keep their address while the table grows
+  ChunkTable chunks;
+  Chunk &first = chunks.emplace({0, 0}, Coord{0, 0});
+  for (int cx = 1; cx < 200; cx++) {
+    chunks.emplace({cx, 0}, Coord{cx, 0});
+  }
+  assert(chunks.find({0, 0}) == &first);
+  assert(chunks.find({199, 0})->get_position() == (Coord{199, 0}));
+  assert(chunks.erase({7, 0}) and chunks.find({7, 0}) == nullptr);
+  assert(chunks.size() == 199);
+  cout << "Chunk slabs: stable addresses across growth - correct\n";
+
+  cout << "All ChunkTable tests PASSED!\n";
+}
+
 void test_screenbuffer() {
   cout << "\n=== SCREENBUFFER TESTS ===\n";
 
@@ -473,20 +1626,57 @@ void test_screenbuffer() {
 #endif
 }
 
-int main() {
+int main(int argc, char **argv) {
 #ifdef _WIN32
   enable_virtual_terminal();
 #endif
 
+  // `game --bench [prefix]`: only the mob benchmark suite, results written
+  // to <prefix>.csv and <prefix>.json.
+  if (argc > 1 and string(argv[1]) == "--bench") {
+    run_mob_benchmark_suite(argc > 2 ? argv[2] : "mob_bench");
+    return 0;
+  }
+
   test_coord();
   test_blocktype();
   test_pixel();
   test_integration();
   test_chunk();
   test_world();
+  test_change_tracking();
+  test_region_file();
+  test_chunk_eviction();
+  test_autosave();
   test_terrain();
+  test_chunk_table();
+  test_screen_diff();
+  test_input();
+  test_frame_clock();
+  test_flow_field();
+  test_astar();
+  test_path_cache();
+  test_mob_grid();
+  test_mob_storage();
+  test_sim_tiers();
+  test_parallel_ai();
   // test_screenbuffer();
   run_aos_vs_soa_benchmark();
+  run_terrain_benchmark();
+  run_chunk_lookup_benchmark();
+  run_render_benchmark();
+  run_screen_diff_benchmark();
+  run_chunk_packing_benchmark();
+  run_region_file_benchmark();
+  run_chunk_eviction_benchmark();
+  run_autosave_benchmark();
+  run_flow_field_benchmark();
+  run_path_context_benchmark();
+  run_astar_benchmark();
+  run_mob_grid_benchmark();
+  run_mob_kernels_benchmark();
+  run_sim_tier_benchmark();
+  run_parallel_ai_benchmark();
 
   cout << "\n=== ALL TESTS PASSED! ===\n";
   cout << "Starting game in 3 seconds...\n";
@@ -495,31 +1685,76 @@ int main() {
   system("cls");
 #endif
 
+  // Edited chunks are kept in region files under world/ between runs.
+  RegionStore region_store("world");
   World world;
+  world.set_region_store(&region_store);
+  // About 20k packed chunks; the far ones are evicted beyond that.
+  world.set_memory_budget(16 << 20);
   ScreenBuffer screen;
 
   int player_x = 40;
   int player_y = 0;
   int facing = 1;
-  int inventory[9] = {0};
+  int inventory[INVENTORY_SLOTS] = {0};
   int selected_block = 1;
 
-  while (player_y < CHUNK_SIZE - 1 &&
-         world.get_block(player_x, player_y) == BlockType::AIR) {
-    ++player_y;
+  // The player and the mobs are saved next to the chunks, in the background
+  // every AUTOSAVE_PERIOD and in full on exit.
+  const std::filesystem::path STATE_FILE = "world/player.bin";
+  const auto AUTOSAVE_PERIOD = std::chrono::seconds(30);
+  Autosaver autosaver(world, region_store, STATE_FILE);
+  PlayerState saved_player;
+  std::vector<Mob> saved_mobs;
+  if (load_game_state(STATE_FILE, saved_player, saved_mobs)) {
+    player_x = saved_player.x;
+    player_y = saved_player.y;
+    facing = saved_player.facing;
+    std::copy_n(saved_player.inventory, INVENTORY_SLOTS, inventory);
+    selected_block = saved_player.selected_block;
+  } else {
+    while (player_y < CHUNK_SIZE - 1 &&
+           world.get_block(player_x, player_y) == BlockType::AIR) {
+      ++player_y;
+    }
+    --player_y;
   }
-  --player_y;
+  auto player_state = [&] {
+    PlayerState player;
+    player.x = player_x;
+    player.y = player_y;
+    player.facing = facing;
+    std::copy_n(inventory, INVENTORY_SLOTS, player.inventory);
+    player.selected_block = selected_block;
+    return player;
+  };
 
   seed_fast_rand(static_cast<unsigned>(time(nullptr)));
 
   GameWindow game_window(world, player_x, player_y, facing, inventory,
                          selected_block);
   InventoryWindow inv_window(inventory, selected_block);
+  for (const Mob &mob : saved_mobs)
+    game_window.get_mobs().add(mob.x, mob.y, mob.hp, mob.type, mob.state);
 
   std::stack<Window *> windows;
   windows.push(&game_window);
 
+  // Simulation runs in fixed 60 Hz steps; rendering is paced to 60 FPS but
+  // may drop below it without slowing the simulation down.
+  const auto FRAME_PERIOD = std::chrono::microseconds(16667);
+  FixedTimestep sim(1.0 / 60.0, 5);
+  FrameStats frame_stats;
+  auto last_frame = FrameClock::now();
+  auto next_frame = last_frame + FRAME_PERIOD;
+  auto next_autosave = last_frame + AUTOSAVE_PERIOD;
+
   while (!windows.empty()) {
+    world.begin_frame();
+    autosaver.poll();
+    if (FrameClock::now() >= next_autosave and
+        autosaver.start(player_state(), game_window.get_mobs()))
+      next_autosave = FrameClock::now() + AUTOSAVE_PERIOD;
     InputState input = get_input();
 
     bool should_close = windows.top()->handle_input(input);
@@ -534,18 +1769,60 @@ int main() {
       windows.push(&inv_window);
     }
 
+    auto now = FrameClock::now();
+    double elapsed = std::chrono::duration<double>(now - last_frame).count();
+    last_frame = now;
+    frame_stats.record(elapsed * 1000.0);
+
+    for (int steps = sim.advance(elapsed); steps > 0; --steps) {
+      windows.top()->update(sim.step_seconds());
+    }
+
+    screen.fit_to_terminal();
     windows.top()->render(screen);
     screen.render();
 
-#ifdef _WIN32
-    Sleep(50);
-#endif
+    // After a stall, pace from now rather than rushing to catch up.
+    if (FrameClock::now() > next_frame)
+      next_frame = FrameClock::now();
+    // Sleep until the next frame or a key press: a key is handled in a
+    // frame of its own right away, and the frame deadline stays put. The
+    // OS wait is trusted to within 2 ms; precise_sleep_until does the rest.
+    auto coarse = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      next_frame - FrameClock::now()) -
+                  std::chrono::milliseconds(2);
+    if (coarse.count() > 0 and
+        wait_for_input(static_cast<int>(coarse.count())))
+      continue;
+    precise_sleep_until(next_frame);
+    next_frame += FRAME_PERIOD;
   }
 
 #ifdef _WIN32
   system("cls");
 #endif
-  cout << "Thanks for playing! Total chunks explored: " << world.chunk_count()
+  if (!autosaver.save_now(player_state(), game_window.get_mobs()))
+    cout << "Could not save the world to " << region_store.directory()
+         << "\n";
+  ResidencyStats residency = world.residency();
+  cout << "Thanks for playing! Chunks resident: " << residency.resident_chunks
+       << " (" << residency.resident_bytes / 1024 << " KiB), evicted: "
+       << residency.evicted_clean + residency.evicted_edited
+       << ", reloaded: " << residency.reloads << "\n";
+  cout << "Frames that waited on chunk generation: "
+       << world.frames_waited_on_generation() << " (placeholders shown in "
+       << world.frames_showing_placeholders() << ")\n";
+  frame_stats.report(cout);
+  const AutosaveStats &saves = autosaver.stats();
+  cout << "Autosaves: " << saves.saves << " (" << saves.chunks_saved
+       << " chunks, " << saves.failures << " failed), worst snapshot "
+       << saves.worst_snapshot_ms << " ms\n";
+  const PathCacheStats &paths = game_window.path_stats();
+  cout << "Mob paths: " << paths.hits << " cached steps, " << paths.replans
+       << " replans (" << paths.edited << " after block edits, "
+       << paths.player_moved << " after the player moved, " << paths.expired
+       << " expired)\n";
+  cout << "Simulation steps dropped after stalls: " << sim.steps_dropped()
        << "\n";
 
   return 0;